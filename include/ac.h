@@ -2,21 +2,67 @@
 #define Ac_h
 
 #include <ArduinoJson.h>  // https://github.com/bblanchon/ArduinoJson
-#include <DHT.h>          // https://github.com/adafruit/DHT-sensor-library
-#include <EEPROM.h>
-#include <IRremoteESP8266.h>  // https://github.com/crankyoldgit/IRremoteESP8266
-#include <IRsend.h>
 #include <WebSocketsServer.h>  // https://github.com/Links2004/arduinoWebSockets
-#include <ir_Daikin.h>
-#include <ir_Panasonic.h>
 
+#include "backend.h"
+#include "binary.h"
+#include "clients.h"
+#include "filter.h"
+#include "framecache.h"
+#include "group.h"
+#include "history.h"
+#include "metrics.h"
+#include "power.h"
+#include "program.h"
+#include "irrx.h"
+#include "irtx.h"
+#include "network.h"
+#include "replay.h"
+#include "scheduler.h"
+#include "sensor.h"
 #include "settings.h"
+#include "state.h"
+#include "stats.h"
+#include "store.h"
+#include "thermostat.h"
+#include "zone.h"
 
-#define DAIKIN 1
-#define PANASONIC 2
+// Commands only hold the state fields, strings point into the payload
+#define COMMAND_DOC_SIZE (JSON_OBJECT_SIZE(12) + JSON_ARRAY_SIZE(4) + JSON_OBJECT_SIZE(2))
 
-// EEPROM Storage Address Locations
-#define S_FAN 210
+// A zone's program, the times are copied
+#define PROGRAM_DOC_SIZE (JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(PROGRAM_ENTRIES) + (JSON_OBJECT_SIZE(4) + 6) * PROGRAM_ENTRIES)
+
+// The results of a replay
+#define REPLAY_DOC_SIZE (JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(10) + JSON_OBJECT_SIZE(4))
+
+// Latencies, heap, per-task, per-client, Wi-Fi and thermostat counters
+#define STATS_DOC_SIZE (JSON_OBJECT_SIZE(5) * (STAT_COUNT + 1) + JSON_OBJECT_SIZE(5) * SCHEDULER_MAX_TASKS + JSON_OBJECT_SIZE(4) * WEBSOCKETS_SERVER_CLIENT_MAX + JSON_ARRAY_SIZE(WEBSOCKETS_SERVER_CLIENT_MAX) + JSON_OBJECT_SIZE(STAT_COUNT + 25) + JSON_OBJECT_SIZE(7) + JSON_OBJECT_SIZE(ZONE_COUNT) + JSON_OBJECT_SIZE(5) * ZONE_COUNT + JSON_OBJECT_SIZE(1))
+
+// Layout of the stored AcStates, bump when it changes incompatibly
+#define STORE_VERSION 1
+
+// Everything that is stored, fields are only ever appended so older records
+// still load
+struct Record {
+    AcState zones[ZONE_MAX];
+    int16_t temperatureOffset;  // sensor calibration in tenths
+    int16_t humidityOffset;
+    WifiCache wifi;             // the AP the last boot connected to
+    uint8_t thermostats;        // zones the controller runs, one bit each
+    uint8_t reserved;
+    ProgramEntry program[PROGRAM_ENTRIES];
+    uint16_t reserved2;
+    uint32_t groupSequence;  // of the last group command taken, see group.h
+};
+
+static_assert(sizeof(Record) == sizeof(AcState) * ZONE_MAX + 4 + sizeof(WifiCache) + 2 + sizeof(ProgramEntry) * PROGRAM_ENTRIES + 6, "Record must not be padded");
+static_assert(sizeof(Record) <= Store::kMaxLength, "Record must fit STORE_SLOT_SIZE");
+
+// Builds a zone and the protocol object only it uses
+#define ZONE_INIT(type, pin, topic) {topic, pin, *[]() -> IrBackend* { static type backend(pin); return &backend; }()},
+
+// Legacy EEPROM Storage Address Locations, only read to migrate
 #define S_VS 230
 #define S_HS 231
 #define S_QM 232
@@ -24,49 +70,108 @@
 
 class Ac {
    public:
-    int mode = AC_MODE;
-
-    WebSocketsServer webSocket = WebSocketsServer(81);
-    DHT dht = DHT(DHT_PIN, DHT_TYPE, 11);
-    IRDaikinESP daikin = IRDaikinESP(IR_PIN);
-    IRPanasonicAc panasonic = IRPanasonicAc(IR_PIN);
+    WebSocketServer webSocket = WebSocketServer(81);
+    Sensor sensor = Sensor(DHT_PIN, DHT_TYPE);
+    History history;
+    Filter temperatureFilter = Filter(SENSOR_OFFSET_T);
+    Filter humidityFilter = Filter(SENSOR_OFFSET_H);
+    Store store = Store(STORE_VERSION, sizeof(Record));
+    Zone zones[ZONE_COUNT] = {ZONES(ZONE_INIT)};
+    Program program;
+#if REPLAY_ENABLED
+    Replay replay;
+#endif
+#if GROUP_ENABLED
+    Group group;
+#endif
+#if THERMOSTAT_ENABLED
+    Thermostat thermostats[ZONE_COUNT];
+#endif
 
     Ac(void);
 
     char* accessoryName;
-    unsigned long loopLastRun;
+    unsigned long lastCommand;
     float currentTemperature;
     float currentHumidity;
-    String targetMode;
-    String targetFanSpeed;
-    int targetTemperature;
-    bool verticalSwing;
-    bool horizontalSwing;
-    bool quietMode;
-    bool powerfulMode;
+    float temperatureRate;  // degrees per minute over the last SENSOR_RATE_MS
+    unsigned long latencyMisses;  // frames sent later than POWER_LATENCY_MS after the command
 
     void begin();
-    void loop();
+    void serve();
+    void schedule(Scheduler& scheduler);
+    bool busy();
+    void sendIfQuiet();
+    void sample();
+    uint32_t sampleInterval();
+    void adapt();
     void webSocketEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
     void getWeather();
-    String toJson();
-    void broadcast();
-    void incomingRequest(String payload);
-    void send();
-    void setTargetMode(String value);
-    void setTargetFanSpeed(String value);
-    void setTemperature(int value);
-    void setVerticalSwing(bool value);
-    void setHorizontalSwing(bool value);
-    void setQuietMode(bool value);
-    void setPowerfulMode(bool value);
-
-   private:
-    bool dirty;
-    void set(int location, int value);
-    int load(int location);
+    void calibrate(JsonVariant offsets);
+#if THERMOSTAT_ENABLED
+    void setThermostat(Zone& zone, bool enabled);
+    bool control(Zone& zone);
+#endif
+    Mode targetMode(const Zone& zone);
+    FanSpeed targetFanSpeed(const Zone& zone);
+    Zone* findZone(const char* topic);
+    void setProgram(uint8_t zone, JsonArray entries);
+    size_t programJson(uint8_t zone, char* out, size_t size);
+    void runProgram();
+    void apply(const ProgramEntry& entry);
+    size_t toJson(const Zone& zone, char* out, size_t size, uint16_t fields = F_ALL);
+    size_t toMsgPack(const Zone& zone, char* out, size_t size, uint16_t fields = F_ALL);
+    void broadcast(bool force = false);
+    void resync();
+    void broadcast(Zone& zone, bool force = false);
+    void incomingRequest(uint8_t num, char* payload, size_t length);
+    void setState(Zone& zone, JsonVariant command);
+    void incomingBinary(uint8_t num, uint8_t* payload, size_t length);
+    size_t statsJson(char* out, size_t size, bool binary = false);
+#if METRICS_ENABLED
+    void writeMetrics(MetricsWriter& out);
+#endif
+    void pushStats();
+    void deliver();
+    void deliver(uint8_t num);
+    static void logSink(void* context, uint8_t level, const char* line, size_t length);
+    void send(Zone& zone);
+#if GROUP_ENABLED
+    void receiveGroup();
+#endif
+#if IR_RECV
+    void receive();
+    void received(Zone& zone, const AcState& state);
+#endif
+#if REPLAY_ENABLED
+    void startReplay(uint8_t num, JsonVariant options);
+    void stopReplay();
+    void replayTick();
+#endif
     void save();
     void restore();
+    const WifiCache& wifiCache() const;
+    void rememberWifi(const WifiCache& cache);
+
+   private:
+    Scheduler* scheduler;
+    Task* broadcastTask;
+    Task* sensorTask;
+#if REPLAY_ENABLED
+    Task* replayTask;
+#endif
+    float rateFrom;  // temperature at the start of the rate window
+    unsigned long rateSince;
+#if IR_ASYNC
+    FrameCache frames;  // the frame playing stays untouched until the transmitter is done
+#endif
+    Client clients[WEBSOCKETS_SERVER_CLIENT_MAX];
+    uint8_t nextZone;         // where the search for a due frame starts
+    Record saved;             // the stored record, including unused zones
+
+    static uint16_t subscribed(const Client& client);
+    bool sendTo(uint8_t num, size_t length, bool binary, size_t& room);
+    void transmit(Zone& zone, uint32_t hash);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,138 @@
+#ifndef Backend_h
+#define Backend_h
+
+#include <IRremoteESP8266.h>  // https://github.com/crankyoldgit/IRremoteESP8266
+#include <IRrecv.h>
+#include <IRsend.h>
+#include <ir_Daikin.h>
+#include <ir_Panasonic.h>
+
+#include "irtx.h"
+#include "settings.h"
+#include "state.h"
+
+// Values of AC_MODE, DAIKIN and PANASONIC are taken by decode_type_t
+#define AC_MODE_DAIKIN 1
+#define AC_MODE_PANASONIC 2
+
+// IR protocol backends. Every zone holds the one configured for it in ZONES,
+// so only those protocol objects are ever built and no setter has to branch
+// on the vendor. Adding a vendor means adding a class here and a case to the
+// Backend typedef below.
+class IrBackend {
+   public:
+    virtual const char* name() const = 0;
+    virtual uint16_t stateLength() const = 0;
+    virtual uint8_t minTemperature() const = 0;  // the range setTemperature() takes
+    virtual uint8_t maxTemperature() const = 0;
+
+    virtual void begin() = 0;
+    virtual void setMode(Mode value) = 0;
+    virtual void setFanSpeed(FanSpeed value) = 0;
+    virtual void setTemperature(uint8_t value) = 0;
+    virtual void setVerticalSwing(bool value) = 0;
+    virtual void setHorizontalSwing(bool value) = 0;
+    virtual void setQuiet(bool value) = 0;
+    virtual void setPowerful(bool value) = 0;
+    virtual void send() = 0;
+    virtual void encode(IrFrame& frame) = 0;
+    virtual uint8_t* raw() = 0;
+    virtual String toString() = 0;
+
+    // Takes a received frame of this protocol into the protocol object and
+    // `state`, returns false for other protocols
+    virtual bool read(const decode_results& results, AcState& state) = 0;
+};
+
+class DaikinBackend : public IrBackend {
+   public:
+    static constexpr const char* kName = "DAIKIN";
+    static const uint16_t kStateLength = kDaikinStateLength;
+
+    explicit DaikinBackend(uint16_t pin);
+
+    const char* name() const override {
+        return kName;
+    }
+
+    uint16_t stateLength() const override {
+        return kStateLength;
+    }
+
+    uint8_t minTemperature() const override {
+        return kDaikinMinTemp;
+    }
+
+    uint8_t maxTemperature() const override {
+        return kDaikinMaxTemp;
+    }
+
+    void begin() override;
+    void setMode(Mode value) override;
+    void setFanSpeed(FanSpeed value) override;
+    void setTemperature(uint8_t value) override;
+    void setVerticalSwing(bool value) override;
+    void setHorizontalSwing(bool value) override;
+    void setQuiet(bool value) override;
+    void setPowerful(bool value) override;
+    void send() override;
+    void encode(IrFrame& frame) override;
+    uint8_t* raw() override;
+    String toString() override;
+    bool read(const decode_results& results, AcState& state) override;
+
+   private:
+    IRDaikinESP ac;
+};
+
+class PanasonicBackend : public IrBackend {
+   public:
+    static constexpr const char* kName = "PANASONIC";
+    static const uint16_t kStateLength = kPanasonicAcStateLength;
+
+    explicit PanasonicBackend(uint16_t pin);
+
+    const char* name() const override {
+        return kName;
+    }
+
+    uint16_t stateLength() const override {
+        return kStateLength;
+    }
+
+    uint8_t minTemperature() const override {
+        return kPanasonicAcMinTemp;
+    }
+
+    uint8_t maxTemperature() const override {
+        return kPanasonicAcMaxTemp;
+    }
+
+    void begin() override;
+    void setMode(Mode value) override;
+    void setFanSpeed(FanSpeed value) override;
+    void setTemperature(uint8_t value) override;
+    void setVerticalSwing(bool value) override;
+    void setHorizontalSwing(bool value) override;
+    void setQuiet(bool value) override;
+    void setPowerful(bool value) override;
+    void send() override;
+    void encode(IrFrame& frame) override;
+    uint8_t* raw() override;
+    String toString() override;
+    bool read(const decode_results& results, AcState& state) override;
+
+   private:
+    IRPanasonicAc ac;
+};
+
+// The vendor of the default zone
+#if AC_MODE == AC_MODE_DAIKIN
+typedef DaikinBackend Backend;
+#elif AC_MODE == AC_MODE_PANASONIC
+typedef PanasonicBackend Backend;
+#else
+#error "AC_MODE must be AC_MODE_DAIKIN or AC_MODE_PANASONIC"
+#endif
+
+#endif
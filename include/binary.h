@@ -0,0 +1,33 @@
+#ifndef Binary_h
+#define Binary_h
+
+// Binary WebSocket protocol, MessagePack arrays with fixed positions.
+//
+// Every message is an array that starts with its MessageType. State and
+// command arrays put the field for F_* bit n at position n + 1, fields that
+// are not sent are nil, and enums are sent as their numeric value:
+//
+//   [0, currentTemperature, currentHumidity, targetMode, targetFanSpeed,
+//    targetTemperature, verticalSwing, horizontalSwing, quietMode,
+//    powerfulMode]
+//   [1, nil, nil, targetMode, ..., powerfulMode, force]
+//   [2]                       stats, answered with the usual stats map
+//   [3, subscriptions]        SUB_* bitmask
+//   [4, level, line]          log line
+//   [5]                       history, answered with JSON text frames
+//
+// A client switches to binary by sending any binary frame or
+// {"binary":true}, and gets binary frames from then on.
+enum MessageType : uint8_t {
+    MSG_STATE,
+    MSG_COMMAND,
+    MSG_STATS,
+    MSG_SUBSCRIBE,
+    MSG_LOG,
+    MSG_HISTORY,
+};
+
+// position of the force flag in a command
+#define MSG_FORCE 10
+
+#endif
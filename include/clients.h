@@ -0,0 +1,77 @@
+#ifndef Clients_h
+#define Clients_h
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>  // https://github.com/Links2004/arduinoWebSockets
+#include <lwip/opt.h>         // TCP_SND_BUF
+
+#include "history.h"
+#include "settings.h"
+
+// Subscriptions
+#define SUB_STATE (1 << 0)   // target state of the zone
+#define SUB_SENSOR (1 << 1)  // current temperature and humidity
+#define SUB_STATS (1 << 2)   // stats every STATS_PUSH_MS
+#define SUB_LOG (1 << 3)     // log lines
+#define SUB_DEFAULT (SUB_STATE | SUB_SENSOR)
+
+// Returns the SUB_* bit for "state", "sensor", "stats" or "log", 0 otherwise
+uint8_t parseSubscription(const char* name);
+
+// Exposes how much the TCP send buffer of a client can take, so writes can
+// be held back instead of blocking the loop until a slow client caught up
+class WebSocketServer : public WebSocketsServer {
+   public:
+    using WebSocketsServer::WebSocketsServer;
+
+    // what an empty send buffer takes
+    static const size_t kSendBuffer = TCP_SND_BUF;
+
+    size_t writable(uint8_t num) {
+        WSclient_t& client = _clients[num];
+        return client.tcp != nullptr ? client.tcp->availableForWrite() : 0;
+    }
+};
+
+// What one WebSocket client asked for and what still has to go out to it.
+//
+// State updates are not queued as messages, the changed fields are or-ed
+// into `fields` and serialized from the current state once the client can
+// take them, so a slow client gets one fresh update instead of a backlog of
+// stale ones. Stats likewise. Log lines are queued as they are, in a small
+// ring, and dropped once it is full.
+class Client {
+   public:
+    static const size_t kQueueSize = CLIENT_QUEUE_SIZE;
+
+    Client(void);
+
+    bool connected;
+    uint8_t zone;
+    uint8_t subscriptions;
+    bool binary;  // MessagePack instead of JSON, see binary.h
+    uint16_t fields;  // state fields not sent yet
+    bool statsPending;
+    bool programPending;     // the zone's program, as a reply
+    uint8_t historySeries;   // the series being sent, SERIES_COUNT when none is
+    uint32_t historyCursor;  // where it continues
+
+    unsigned long sent;
+    unsigned long dropped;    // queued messages that did not fit
+    unsigned long coalesced;  // updates merged into one not sent yet
+
+    void reset(uint8_t zone);
+    void setBinary(bool value);
+    void requestHistory();
+    void update(uint16_t fields);
+    bool push(const char* data, size_t length);
+    size_t peek(char* out, size_t size) const;
+    void pop();
+
+   private:
+    char queue[kQueueSize];
+    uint32_t head;
+    uint32_t tail;
+};
+
+#endif
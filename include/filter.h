@@ -0,0 +1,29 @@
+#ifndef Filter_h
+#define Filter_h
+
+#include <Arduino.h>
+
+#include "settings.h"
+
+// Smooths one sensor series in tenths: a median over the last
+// FILTER_MEDIAN samples throws out single spikes, an exponential moving
+// average with weight FILTER_EMA / 256 evens out the rest, and the
+// calibration offset is added last. Integer math only, no allocations.
+class Filter {
+   public:
+    static const uint8_t kWindow = FILTER_MEDIAN;
+
+    explicit Filter(int16_t offset);
+
+    int16_t add(int16_t value);
+
+    int16_t offset;  // calibration in tenths
+
+   private:
+    int16_t window[kWindow];
+    uint8_t count;
+    uint8_t next;
+    int32_t average;  // in 1/256 tenths
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef FrameCache_h
+#define FrameCache_h
+
+#include <Arduino.h>
+
+#include "irtx.h"
+#include "settings.h"
+#include "state.h"
+
+// Keeps the last FRAME_CACHE_SIZE encoded IR frames, so a state that was sent
+// before goes out again without encoding it. Entries are looked up by AcState
+// and checked against the hash of the protocol bytes, as an off frame still
+// carries the mode it was switched off from. The least recently used entry is
+// replaced on a miss.
+class FrameCache {
+   public:
+    static const uint8_t kSize = FRAME_CACHE_SIZE;
+
+    FrameCache(void);
+
+    IrFrame* find(const AcState& state, uint32_t hash);
+    IrFrame* insert(const AcState& state, uint32_t hash);
+
+    unsigned long hits;
+    unsigned long misses;
+
+   private:
+    struct Entry {
+        AcState state;
+        uint32_t hash;
+        uint32_t used;  // clock value of the last use, 0 = empty
+        IrFrame frame;
+    };
+
+    Entry entries[kSize];
+    uint32_t clock;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef Group_h
+#define Group_h
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include "settings.h"
+
+#if GROUP_ENABLED
+#include <bearssl/bearssl_hmac.h>
+
+// Packet types
+#define GROUP_COMMAND 1
+#define GROUP_ACK 2
+
+#define GROUP_VERSION 1
+#define GROUP_MAC_SIZE 32  // HMAC-SHA256
+
+// Every packet starts with this, little endian, then comes the JSON body and
+// the HMAC-SHA256 of both under GROUP_KEY
+struct GroupHeader {
+    char magic[2];      // "AG"
+    uint8_t version;    // GROUP_VERSION
+    uint8_t type;       // GROUP_COMMAND or GROUP_ACK
+    uint32_t sequence;  // the sender counts up, acks echo it
+};
+
+static_assert(sizeof(GroupHeader) == 8, "GroupHeader must not be padded");
+
+// Commands for many devices in one packet. Every device joins the multicast
+// group it announces over mDNS and takes the JSON commands of WebSocket
+// clients from it, e.g. {"targetMode":"off"}, with "zone" naming a topic to
+// only reach that zone. Commands are signed with the shared GROUP_KEY, and
+// only one with a higher sequence than the last one taken is applied, which
+// is stored, so a recorded packet cannot be played again. Each device
+// acknowledges to the sender by unicast, a repeated packet only gets the ack
+// again.
+class Group {
+   public:
+    Group(void);
+
+    bool begin();
+    char* read(size_t& length);
+    void ack(const char* body, size_t length);
+
+    uint32_t sequence;  // of the last command taken
+    unsigned long received;
+    unsigned long rejected;  // malformed, wrong key or an old sequence
+    unsigned long repeated;  // sent again as the ack was lost
+
+   private:
+    WiFiUDP udp;
+    IPAddress address;
+    br_hmac_key_context key;
+    IPAddress sender;
+    uint16_t senderPort;
+    uint8_t packet[GROUP_PACKET_SIZE];
+
+    void sign(const uint8_t* data, size_t length, uint8_t* mac);
+    void send(uint8_t type, const char* body, size_t length);
+};
+#endif  // GROUP_ENABLED
+
+#endif
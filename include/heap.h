@@ -0,0 +1,12 @@
+#ifndef Heap_h
+#define Heap_h
+
+#include <Arduino.h>
+
+// Heap allocations since boot. The linker wraps malloc, calloc and realloc
+// (-Wl,--wrap, see platformio.ini), which operator new and String go
+// through as well. The SDK and lwIP allocate with pvPortMalloc and are not
+// counted, neither is newlib, which calls the allocator directly.
+uint32_t heapAllocations();
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef History_h
+#define History_h
+
+#include <Arduino.h>
+
+#include "settings.h"
+
+// Recent sensor readings, kept in RAM.
+//
+// The last HISTORY_SAMPLES samples are kept as they are. Every sample is
+// also folded into the current minute and hour, which are moved into their
+// own rings when they are over, so the aggregates cost nothing to look up.
+// Values are stored in tenths, the resolution of the DHT22. Times are
+// seconds since boot.
+class History {
+   public:
+    enum Series : uint8_t {
+        SAMPLES,
+        MINUTES,
+        HOURS,
+        SERIES_COUNT,
+    };
+
+    struct Sample {
+        uint32_t time;
+        int16_t temperature;  // kMissing when the read failed
+        uint16_t humidity;
+    };
+
+    struct Aggregate {
+        uint32_t start;
+        uint16_t count;  // good samples
+        int16_t minTemperature;
+        int16_t maxTemperature;
+        uint16_t minHumidity;
+        uint16_t maxHumidity;
+        int32_t sumTemperature;
+        uint32_t sumHumidity;
+    };
+
+    static const int16_t kMissing = INT16_MIN;
+
+    History(void);
+
+    void add(float temperature, float humidity);
+    void addMissing();
+    size_t toJson(Series series, uint32_t& cursor, char* out, size_t size);
+
+   private:
+    Sample samples[HISTORY_SAMPLES];
+    Aggregate minutes[HISTORY_MINUTES];
+    Aggregate hours[HISTORY_HOURS];
+    uint16_t sampleCount;
+    uint16_t nextSample;
+    uint8_t minuteCount;
+    uint8_t nextMinute;
+    uint8_t hourCount;
+    uint8_t nextHour;
+    Aggregate minute;  // the current minute and hour
+    Aggregate hour;
+
+    void record(uint32_t time, int16_t temperature, uint16_t humidity);
+    static void open(Aggregate& aggregate, uint32_t start);
+    static void fold(Aggregate& aggregate, int16_t temperature, uint16_t humidity);
+};
+
+#endif
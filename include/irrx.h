@@ -0,0 +1,37 @@
+#ifndef IrRx_h
+#define IrRx_h
+
+#include <Arduino.h>
+#include <IRrecv.h>
+
+#include "settings.h"
+
+#define IR_RECV (IR_RECV_PIN >= 0)
+
+#if IR_RECV
+// Captures the frames of the AC's own remote. IRrecv records the pin edges
+// from a GPIO interrupt into its buffer, read() only decodes a finished
+// capture. The receiver would hear our own frames too and its interrupt
+// would jitter their carrier, so it is paused while they play.
+class IrReceiver {
+   public:
+    IrReceiver(void);
+
+    void begin();
+    void pause();
+    void resume();
+    bool read(decode_results& results);
+
+    unsigned long frames;     // decoded
+    unsigned long unknown;    // captured, but no protocol matched
+    unsigned long overflows;  // longer than IR_RECV_BUFFER
+
+   private:
+    IRrecv irrecv;
+    bool paused;
+};
+
+extern IrReceiver irReceiver;
+#endif  // IR_RECV
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef IrTx_h
+#define IrTx_h
+
+#include <Arduino.h>
+
+#include "settings.h"
+
+#define IR_MAX_SYMBOLS 8
+
+// A fully encoded IR frame. Every mark and space is stored as an index into
+// the handful of distinct durations the protocol uses, which keeps a Daikin
+// frame at about 600 bytes instead of 2.4 KB of raw timings.
+struct IrFrame {
+    uint32_t frequency;                  // carrier in Hz
+    uint32_t gap;                        // quiet time after the last mark in us
+    uint16_t durations[IR_MAX_SYMBOLS];  // us per symbol
+    uint8_t symbolCount;
+    bool overflow;
+    uint16_t length;
+    uint8_t symbols[IR_FRAME_SIZE];  // marks at even, spaces at odd positions
+
+    void begin(uint32_t frequency, uint32_t gap);
+    void add(uint16_t us);
+    void section(uint16_t headerMark, uint16_t headerSpace, uint16_t bitMark, uint16_t oneSpace, uint16_t zeroSpace, uint16_t footerSpace, const uint8_t* data, uint16_t bits);
+};
+
+// Plays IrFrames on a pin from the timer1 interrupt, including the carrier,
+// so starting a transmission returns immediately. Only one frame plays at a
+// time and the timer is not available to analogWrite, tone or Servo.
+class IrTransmitter {
+   public:
+    IrTransmitter(void);
+
+    void begin();
+    bool start(const IrFrame& frame, uint8_t pin);
+    bool busy();
+    bool finished();
+
+    unsigned long frames;
+};
+
+extern IrTransmitter irTransmitter;
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef Log_h
+#define Log_h
+
+#include <Arduino.h>
+
+#include "settings.h"
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Receives complete lines, without the trailing newline
+typedef void (*LogSink)(void* context, uint8_t level, const char* line, size_t length);
+
+// Leveled logger writing into a ring buffer.
+//
+// log() only formats into the buffer. drain() is run by the scheduler and
+// hands the UART just as many bytes as its FIFO has room for, and complete
+// lines to the extra sinks (WebSocket clients, syslog). When the buffer is
+// full new lines are dropped and counted rather than waiting for the UART.
+class Logger {
+   public:
+    static const size_t kBufferSize = LOG_BUFFER_SIZE;
+    static const size_t kLineSize = LOG_LINE_SIZE;
+    static const uint8_t kMaxSinks = 2;
+
+    Logger(void);
+
+    void log(uint8_t level, const char* format, ...) __attribute__((format(printf, 3, 4)));
+    void addSink(LogSink sink, void* context);
+    void setHostname(const char* name);
+    void drain();
+    void flush();
+
+    unsigned long dropped;
+
+   private:
+    char buffer[kBufferSize];
+    uint32_t head;
+    uint32_t uartTail;
+    uint32_t lineTail;
+
+    LogSink sinks[kMaxSinks];
+    void* contexts[kMaxSinks];
+    uint8_t sinkCount;
+    const char* hostname;
+
+    void append(const char* data, size_t length);
+    void drainUart(size_t room);
+    bool drainLine();
+    static void syslog(void* context, uint8_t level, const char* line, size_t length);
+};
+
+extern Logger logger;
+
+// Format strings stay in flash, levels above LOG_LEVEL compile out
+#define LOG_AT(level, format, ...) logger.log(level, PSTR(format), ##__VA_ARGS__)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(format, ...) \
+    do {                       \
+    } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(format, ...) LOG_AT(LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#else
+#define LOG_WARN(format, ...) \
+    do {                      \
+    } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#else
+#define LOG_INFO(format, ...) \
+    do {                      \
+    } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(format, ...) LOG_AT(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(format, ...) \
+    do {                       \
+    } while (0)
+#endif
+
+#endif
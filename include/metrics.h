@@ -0,0 +1,56 @@
+#ifndef Metrics_h
+#define Metrics_h
+
+#include <Arduino.h>
+
+#include "settings.h"
+
+#if METRICS_ENABLED
+#include <ESP8266WebServer.h>
+
+// The HELP and TYPE lines of a metric, kept in flash
+#define METRIC_FAMILY(out, name, type, help) out.line(PSTR("# HELP " name " " help "\n# TYPE " name " " type "\n"))
+
+// Writes the Prometheus text format into a small buffer that goes out as a
+// chunk of the response whenever it fills, so the body never exists whole
+class MetricsWriter {
+   public:
+    explicit MetricsWriter(ESP8266WebServer& server);
+
+    void line(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    void flush();
+
+    size_t sent;            // bytes
+    unsigned long dropped;  // lines too long for a chunk
+
+   private:
+    ESP8266WebServer& server;
+    char buffer[METRICS_CHUNK_SIZE];
+    size_t length;
+};
+
+class Ac;
+
+// Serves http://host/metrics for scrapers, so they need no WebSocket
+class Metrics {
+   public:
+    Metrics(void);
+
+    void begin(Ac& ac);
+    void loop();
+
+    unsigned long scrapes;
+    unsigned long dropped;  // lines, over all scrapes
+    uint32_t lastMs;  // time the last scrape took
+
+   private:
+    ESP8266WebServer server;
+    Ac* ac;
+
+    void handle();
+};
+
+extern Metrics metrics;
+#endif  // METRICS_ENABLED
+
+#endif
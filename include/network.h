@@ -0,0 +1,63 @@
+#ifndef Network_h
+#define Network_h
+
+#include <Arduino.h>
+
+#include "settings.h"
+
+// Where the access point was found last, stored so a boot can skip the scan
+struct WifiCache {
+    uint8_t bssid[6];
+    uint8_t channel;  // 0 = nothing cached
+    uint8_t reserved;
+};
+
+static_assert(sizeof(WifiCache) == 8, "WifiCache must not be padded");
+
+// Station connection with the credentials WiFiManager stored.
+//
+// Every attempt first goes straight to the cached BSSID and channel, which
+// associates in a few hundred ms instead of scanning all channels. If the
+// AP moved it falls back to a scan. At boot connect() blocks, and only if
+// it fails the caller opens the WiFiManager portal. Once connected loop()
+// supervises the link and reconnects the same way without blocking, in
+// place of the SDK's own reconnect which scans and backs off.
+class Network {
+   public:
+    enum State : uint8_t {
+        OFFLINE,   // not supervised yet
+        ONLINE,
+        CACHED,    // reassociating with the cached AP
+        SCANNING,  // looking for any AP with the SSID
+    };
+
+    Network(void);
+
+    bool connect(uint32_t timeoutMs);
+    bool remember();
+    void begin();
+    bool loop();
+
+    WifiCache cache;
+    State state;
+    bool cached;              // the last connection came from the cache
+
+    unsigned long connectMs;  // of the boot connect()
+    unsigned long drops;
+    unsigned long reconnects;
+    unsigned long cachedReconnects;
+    uint32_t lastReconnectMs;
+    uint32_t maxReconnectMs;
+
+   private:
+    unsigned long lostAt;
+    unsigned long attemptAt;
+
+    void attempt(bool fromCache);
+    bool online();
+    bool wait(unsigned long started, uint32_t timeoutMs);
+};
+
+extern Network network;
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef Power_h
+#define Power_h
+
+#include <Arduino.h>
+
+#include "settings.h"
+
+#define POWER_OFF 0
+#define POWER_MODEM_SLEEP 1
+#define POWER_LIGHT_SLEEP 2
+
+// Period of the tasks that used to poll on every pass, they are the ones
+// the loop has to wake up for
+#define POLL_MS (POWER_SAVE ? POWER_POLL_MS : 0)
+
+// Beacon interval of most access points, 100 TU
+#define BEACON_MS 102
+
+// Wi-Fi sleep between the scheduled tasks.
+//
+// The radio only wakes for every listenInterval-th DTIM beacon, picked so
+// that waiting for the beacon, the poll period and the command coalescing
+// together stay within POWER_LATENCY_MS. The loop sleeps until the next
+// task is due, which lets the core enter modem or light sleep.
+class Power {
+   public:
+    Power(void);
+
+    void begin();
+    void idle(uint32_t ms);
+
+    uint8_t listenInterval;
+    unsigned long sleeps;
+    unsigned long sleptMs;
+};
+
+extern Power power;
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef Program_h
+#define Program_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "settings.h"
+#include "state.h"
+
+#define MINUTES_PER_DAY 1440
+#define MINUTES_PER_WEEK 10080
+
+// Leaves the mode of the zone as it is
+#define PROGRAM_KEEP 0xFF
+
+// One setpoint change a week, on the days set in `days`. Stored as is.
+struct ProgramEntry {
+    uint8_t days;         // bit 0 = Sunday as in tm_wday, 0 = unused entry
+    uint8_t zone;
+    uint16_t minute;      // of the day, local time
+    uint8_t mode;         // a Mode or PROGRAM_KEEP
+    uint8_t temperature;  // 0 leaves it
+};
+
+static_assert(sizeof(ProgramEntry) == 6, "ProgramEntry must not be padded");
+
+// Weekly setpoint program, run by the device from NTP time.
+//
+// The entries live in the stored record and are set with
+// {"program":[{"days":62,"at":"07:00","mode":"heat","temperature":21}]},
+// which replaces those of the client's zone. tick() hands out every minute
+// of the week once as the clock passes it, so an entry fires once even if
+// the loop was busy during its minute, and minutes missed for more than
+// PROGRAM_CATCH_UP_MIN, e.g. while the clock was not set, are skipped.
+class Program {
+   public:
+    Program(void);
+
+    void begin();
+    bool synced() const;
+    bool tick(uint16_t& weekMinute);
+
+    static bool matches(const ProgramEntry& entry, uint16_t weekMinute);
+    static bool parse(JsonVariant value, uint8_t zone, ProgramEntry& entry);
+    static void toJson(const ProgramEntry& entry, JsonObject out);
+
+    unsigned long runs;  // entries applied
+
+   private:
+    uint16_t last;  // the last minute handed out, UINT16_MAX before the first
+};
+
+#endif
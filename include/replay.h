@@ -0,0 +1,54 @@
+#ifndef Replay_h
+#define Replay_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "settings.h"
+#include "state.h"
+#include "stats.h"
+
+// Feeds a recorded trace of Homebridge commands into the command path at a
+// fixed rate to measure what the device sustains, started with
+// {"replay":{"rate":20,"count":500,"ir":false}}.
+//
+// Every command is timed from the moment it goes in until the state that
+// acknowledges it goes out to the client that started the replay. Commands
+// coalesce like real ones, so one acknowledgement can end several timings.
+class Replay {
+   public:
+    Replay(void);
+
+    void start(uint8_t num, uint8_t zone, uint16_t rate, uint32_t count, bool ir);
+    void stop();
+    size_t next(char* out, size_t size);
+    void acknowledged();
+    bool finished() const;
+    uint32_t period() const;
+    void toJson(JsonObject out);
+
+    bool active;
+    bool ir;              // send the IR frames, off only exercises the software
+    bool reportPending;   // the results wait for delivery
+    uint8_t client;
+    uint8_t zone;         // of the client, restored by Ac once done
+    uint16_t rate;        // commands per second
+    uint32_t count;
+    uint32_t issued;
+    uint32_t acked;
+    uint32_t unmeasured;  // issued while REPLAY_PENDING timings were open
+    uint32_t minFreeHeap;
+    AcState saved;        // the zone as it was before
+
+    LatencyStat latency;
+
+   private:
+    unsigned long startedAt;
+    unsigned long lastAt;  // the last command went in
+    uint16_t position;
+    uint32_t pending[REPLAY_PENDING];  // micros() of the commands not acked yet
+    uint8_t head;
+    uint8_t tail;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef Scheduler_h
+#define Scheduler_h
+
+#include <Arduino.h>
+
+#include "settings.h"
+
+typedef void (*TaskCallback)(void* context);
+
+struct Task {
+    const char* name;
+    TaskCallback callback;
+    void* context;
+    uint32_t period;  // ms between runs, 0 runs on every pass
+    uint32_t budget;  // us a run may take before it counts as an overrun
+    uint8_t priority;
+    unsigned long due;
+
+    unsigned long runs;
+    unsigned long overruns;  // runs that took longer than the budget
+    unsigned long misses;    // runs that started more than a period late
+    uint32_t maxTime;        // longest run in us
+    unsigned long allocations;  // heap allocations made by its runs
+    bool allocates;             // runs library code that may allocate at any time
+};
+
+// Cooperative scheduler for the main loop.
+//
+// Every pass runs all due I/O tasks, then at most one other task, the one
+// that is the most overdue. A slow task therefore delays WebSocket and mDNS
+// by one run at the most, and its overruns show up in its counters.
+//
+// Every run is also checked for heap allocations. Once HEAP_STEADY_MS have
+// passed since boot, a task that is not marked with allowHeap() must not
+// allocate any more, so the heap cannot fragment however long it runs. Our
+// code called from an exempt task checks itself with checkHeap().
+class Scheduler {
+   public:
+    enum Priority : uint8_t {
+        IO,
+        NORMAL,
+    };
+
+    static const uint8_t kMaxTasks = SCHEDULER_MAX_TASKS;
+
+    Scheduler(void);
+
+    Task* add(const char* name, TaskCallback callback, void* context, uint32_t period, uint32_t budget, Priority priority = NORMAL);
+    void setPeriod(Task* task, uint32_t period);
+    void wake(Task* task);
+    void allowHeap(Task* task);
+    void checkHeap(const char* name, uint32_t allocations);
+    void run();
+    uint32_t idleTime();
+    void report();
+
+    Task tasks[kMaxTasks];
+    uint8_t count;
+    unsigned long steadyAllocations;  // by tasks that must not allocate, once steady
+
+   private:
+    bool steady;  // HEAP_STEADY_MS have passed, latched so the millis() wrap does not undo it
+
+    void execute(Task& task, unsigned long now);
+};
+
+#endif
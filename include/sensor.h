@@ -0,0 +1,66 @@
+#ifndef Sensor_h
+#define Sensor_h
+
+#include <Arduino.h>
+
+#include "settings.h"
+
+// Non-blocking DHT11 / DHT22 reader.
+//
+// The DHT library bit-bangs the whole transfer with interrupts disabled. Here
+// the start pulse is timed from loop() and the 40 data bits are timed by a
+// pin change interrupt, so every call to loop() returns within a few
+// microseconds and the last good sample is served until a new one arrives.
+class Sensor {
+   public:
+    enum Phase : uint8_t {
+        IDLE,     // waiting for the next sample to be due
+        START,    // holding the line low to wake the sensor
+        CAPTURE,  // line released, edges are recorded by the interrupt
+    };
+
+    Sensor(uint8_t pin, uint8_t type);
+
+    void begin();
+    void loop(bool busy);
+    void request();
+    void setInterval(unsigned long ms);
+    bool available();
+    bool missed();
+
+    bool valid() const;
+    float temperature() const;
+    float humidity() const;
+    unsigned long age() const;
+
+    Phase phase;
+    unsigned long overruns;
+    unsigned long failures;
+
+   private:
+    static const uint8_t kMaxPulses = 48;
+
+    uint8_t pin;
+    uint8_t type;
+    uint8_t retries;
+    unsigned long interval;
+    bool fresh;
+    bool lost;  // a read failed including its retries
+    bool hasSample;
+    float lastTemperature;
+    float lastHumidity;
+    unsigned long sampledAt;
+    unsigned long dueAt;
+    unsigned long phaseStart;
+
+    volatile uint8_t count;
+    volatile uint32_t rise;
+    volatile uint8_t pulses[kMaxPulses];
+
+    static void IRAM_ATTR onEdge(void* arg);
+    void finish();
+    bool decode();
+    void schedule(unsigned long delayMs);
+};
+
+#endif
@@ -2,4 +2,128 @@
 #define IR_PIN 4     // D2, GPIO4
 #define DHT_PIN 5    // D1, GPIO5
 #define DHT_TYPE 22  // DHT11 = 11, DHT22 = 22
-#define AC_MODE 2    // DAIKIN = 1, PANASONIC = 2
+#define AC_MODE 2    // AC_MODE_DAIKIN = 1, AC_MODE_PANASONIC = 2
+#define IR_RECV_PIN -1  // IR receiver for the AC's own remote, e.g. 14 for D5, -1 = none
+
+/* Zone Settings */
+// One ZONE(backend, pin, topic) per indoor unit, at most 4. Clients pick a
+// zone with the URL, ws://host:81/<topic>, the first zone also takes "/".
+// Async IR needs the pins to be GPIO0 to GPIO15.
+#define ZONES(ZONE) ZONE(Backend, IR_PIN, "ac")
+// #define ZONES(ZONE) ZONE(DaikinBackend, 4, "living") ZONE(PanasonicBackend, 14, "bedroom")
+
+/* IR Settings */
+#define IR_ASYNC 1         // play frames from the timer1 interrupt, 0 = blocking IRsend
+#define IR_FRAME_SIZE 600  // marks and spaces per frame, a Daikin frame has 584
+#define FRAME_CACHE_SIZE 4  // encoded frames kept for reuse, about IR_FRAME_SIZE bytes each
+#define IR_RECV_BUFFER 1024    // captured marks and spaces, 2 bytes each, a Daikin frame has 584
+#define IR_RECV_TIMEOUT_MS 50  // silence that ends a capture, above the 29 ms Daikin section gap
+
+/* Sensor Settings */
+#define SENSOR_INTERVAL_MS 30000  // time between DHT samples while an AC runs
+#define SENSOR_ADAPTIVE 1         // sample and broadcast faster or slower depending on activity
+#define SENSOR_FAST_MS 10000      // interval after a mode change or while the temperature moves
+#define SENSOR_IDLE_MS 300000     // interval while all zones are off and nothing moves
+#define SENSOR_ACTIVE_MS 600000   // how long a mode change counts as activity
+#define SENSOR_FAST_RATE 0.05     // degrees per minute that count as moving
+#define SENSOR_RATE_MS 300000     // window the rate is measured over, a 0.1 degree step in it stays slow
+#define SENSOR_RETRY_MS 2000      // time before retrying a failed sample
+#define SENSOR_RETRIES 3          // retries before waiting a full interval
+#define SENSOR_QUIET_MS 250       // hold off samples this long after a command
+#define SENSOR_BUDGET_US 200      // a sensor step taking longer counts as an overrun
+#define FILTER_MEDIAN 3           // samples the median is taken over, 1 = no median
+#define FILTER_EMA 128            // weight of a new sample out of 256, 256 = no averaging
+#define SENSOR_OFFSET_T 0         // calibration in tenths of a degree, until set with {"calibrate":...}
+#define SENSOR_OFFSET_H 0         // calibration in tenths of a percent
+#define HISTORY_SAMPLES 120       // raw samples kept, an hour at 30 s
+#define HISTORY_MINUTES 60        // one minute aggregates kept
+#define HISTORY_HOURS 24          // one hour aggregates kept
+
+/* Thermostat Settings */
+#define THERMOSTAT_ENABLED 1          // on-device control loop, turned on per zone with {"thermostat":true}
+#define THERMOSTAT_HYSTERESIS 0.5     // degrees past the target before the unit starts or idles
+#define THERMOSTAT_BOOST 2.0          // degrees off the target for full fan, if the fan is on auto
+#define THERMOSTAT_MIN_ON_MS 300000   // shortest compressor run
+#define THERMOSTAT_MIN_OFF_MS 180000  // shortest compressor rest
+#define THERMOSTAT_STALE_MS 900000    // older readings are not acted on
+
+/* Program Settings */
+#define PROGRAM_ENTRIES 8              // weekly setpoint changes kept, 6 bytes each in the stored record
+#define PROGRAM_NTP_SERVER "pool.ntp.org"
+#define PROGRAM_TIMEZONE "UTC0"        // POSIX TZ, e.g. "CET-1CEST,M3.5.0,M10.5.0/3"
+#define PROGRAM_CATCH_UP_MIN 10        // entries missed by more than this are skipped
+#define PROGRAM_POLL_MS 1000           // how often the clock is checked
+
+/* Command Settings */
+#define SEND_QUIET_MS 60       // send once no command arrived for this long
+#define SEND_MAX_DELAY_MS 250  // send at the latest this long after the first command
+#define SEND_DEDUPE_MS 600000  // skip a frame identical to the last one sent this recently, 0 = never skip
+
+/* Broadcast Settings */
+#define BROADCAST_INTERVAL_MS 30000  // periodic broadcast, skipped when nothing changed
+#define BROADCAST_DELTA 0           // 1 = only send changed fields, the plugin must merge partial updates
+#define BROADCAST_HYSTERESIS_T 0.2  // smallest temperature change worth a broadcast
+#define BROADCAST_HYSTERESIS_H 1.0  // smallest humidity change worth a broadcast
+#define JSON_BUFFER_SIZE 3072       // outgoing JSON, the stats reply is the largest message
+#define CLIENT_QUEUE_SIZE 256       // queued log lines per client, must be a power of two
+#define STATS_PUSH_MS 10000         // stats for clients that sent {"subscribe":["stats"]}
+
+/* Wi-Fi Settings */
+#define FAST_BOOT 1                    // connect with the stored credentials and the cached AP, the portal only if that fails
+#define WIFI_CONNECT_TIMEOUT_MS 10000  // fast boot gives up and opens the portal after this
+#define WIFI_CACHED_TIMEOUT_MS 3000    // a scan follows if the cached AP does not answer within this
+#define WIFI_PORTAL_TIMEOUT_S 600      // the portal closes and the device resets after this
+#define WIFI_SUPERVISE_MS 250          // how often the link is checked once up
+
+/* Power Settings */
+#define POWER_SAVE 1           // 0 = poll flat out, 1 = modem sleep, 2 = light sleep
+#define POWER_LATENCY_MS 500   // worst case from a command to its IR frame, sets the listen interval
+#define POWER_POLL_MS 20       // how often WebSocket and mDNS are polled while sleeping
+
+/* Group Settings */
+#define GROUP_ENABLED 0                // take signed commands sent to a multicast group, see group.h
+#define GROUP_ADDRESS "239.255.67.65"  // announced as the "group" mDNS TXT record
+#define GROUP_PORT 4210                // announced as "groupPort"
+#define GROUP_KEY ""                   // shared HMAC-SHA256 secret of the fleet, at least 16 characters
+#define GROUP_PACKET_SIZE 512          // largest packet taken, header and signature included
+
+/* Metrics Settings */
+#define METRICS_ENABLED 1       // serve Prometheus metrics on http://host/metrics
+#define METRICS_PORT 80
+#define METRICS_CHUNK_SIZE 512  // bytes per chunk of the response, the body is never held whole
+
+/* Replay Settings */
+#define REPLAY_ENABLED 0     // accept {"replay":{...}} to benchmark the command path, see replay.h
+#define REPLAY_RATE 10       // commands per second unless the command sets "rate"
+#define REPLAY_MAX_RATE 200  // faster than the scheduler can tick
+#define REPLAY_PENDING 32    // commands timed at once, must be a power of two
+
+/* Storage Settings */
+#define STORE_INTERVAL_MS 10000  // at most one flash write this often
+#define STORE_SLOT_SIZE 128      // bytes per record, a flash sector holds 4096 / STORE_SLOT_SIZE records
+#define STORE_POLL_MS 1000       // how often to check for staged writes
+
+/* Scheduler Settings */
+#define SCHEDULER_MAX_TASKS 18
+#define SCHEDULER_REPORT_MS 0           // print the task counters this often, 0 = never
+#define HEAP_STEADY_MS 60000            // from boot, tasks must not allocate after this, see scheduler.h
+#define HEAP_STRICT 0                   // 1 = panic on such an allocation instead of counting it, for soak tests
+#define TASK_BUDGET_IO_US 5000          // WebSocket and mDNS polls
+#define TASK_BUDGET_SEND_US 150000      // a whole IR frame
+#define TASK_BUDGET_BROADCAST_US 10000  // serialize and send to all clients
+#define TASK_BUDGET_STORE_US 100000     // a sector erase
+
+/* Log Settings */
+#define SERIAL_BAUD 115200
+#define LOG_LEVEL LOG_LEVEL_INFO       // lines above this level compile out, LOG_LEVEL_DEBUG dumps the IR state
+#define LOG_BUFFER_SIZE 1024           // ring buffer, must be a power of two
+#define LOG_LINE_SIZE 128              // longer lines are cut
+#define LOG_UART 1                     // write the log to the serial port
+#define LOG_WEBSOCKET 1                // send the log to clients that sent {"log":true}
+#define LOG_SYSLOG 0                   // send the log as UDP syslog
+#define LOG_SYSLOG_HOST "192.168.1.2"
+#define LOG_SYSLOG_PORT 514
+
+/* Instrumentation Settings */
+#define STATS_ENABLED 1          // time the hot paths, query with {"stats":true}
+#define STATS_HEAP_MS 1000       // how often to sample the heap
@@ -0,0 +1,97 @@
+#ifndef State_h
+#define State_h
+
+#include <Arduino.h>
+
+#include <type_traits>
+
+enum Mode : uint8_t {
+    MODE_OFF,
+    MODE_COOL,
+    MODE_HEAT,
+    MODE_FAN,
+    MODE_AUTO,
+    MODE_DRY,
+};
+
+enum FanSpeed : uint8_t {
+    FAN_AUTO,
+    FAN_MIN,
+    FAN_MAX,
+};
+
+enum Swing : uint8_t {
+    SWING_NONE = 0,
+    SWING_VERTICAL = 1 << 0,
+    SWING_HORIZONTAL = 1 << 1,
+    SWING_BOTH = SWING_VERTICAL | SWING_HORIZONTAL,
+};
+
+// FNV-1a
+inline uint32_t fnv1a(const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint32_t res = 2166136261UL;
+    for (size_t i = 0; i < length; i++) {
+        res = (res ^ bytes[i]) * 16777619UL;
+    }
+    return res;
+}
+
+// Everything the IR protocols need to know about the AC. It is plain bytes
+// without padding, so it can be compared, hashed and stored with memcmp and
+// memcpy.
+struct AcState {
+    Mode mode;
+    FanSpeed fanSpeed;
+    Swing swing;
+    uint8_t temperature;
+    bool quiet;
+    bool powerful;
+
+    bool verticalSwing() const {
+        return swing & SWING_VERTICAL;
+    }
+
+    bool horizontalSwing() const {
+        return swing & SWING_HORIZONTAL;
+    }
+
+    void setSwing(Swing axis, bool value) {
+        swing = (Swing)(value ? swing | axis : swing & ~axis);
+    }
+
+    bool operator==(const AcState& other) const {
+        return memcmp(this, &other, sizeof(AcState)) == 0;
+    }
+
+    bool operator!=(const AcState& other) const {
+        return !(*this == other);
+    }
+
+    uint32_t hash() const {
+        return fnv1a(this, sizeof(AcState));
+    }
+};
+
+static_assert(sizeof(AcState) == 6, "AcState must not be padded");
+static_assert(std::is_trivially_copyable<AcState>::value, "AcState must be trivially copyable");
+
+// Protocol names, only used when talking JSON
+constexpr const char* kModeNames[] = {"off", "cool", "heat", "fan", "auto", "dry"};
+constexpr const char* kFanSpeedNames[] = {"auto", "min", "max"};
+constexpr uint8_t kModeCount = sizeof(kModeNames) / sizeof(kModeNames[0]);
+constexpr uint8_t kFanSpeedCount = sizeof(kFanSpeedNames) / sizeof(kFanSpeedNames[0]);
+
+constexpr const char* modeName(Mode value) {
+    return value < sizeof(kModeNames) / sizeof(kModeNames[0]) ? kModeNames[value] : kModeNames[MODE_OFF];
+}
+
+constexpr const char* fanSpeedName(FanSpeed value) {
+    return value < sizeof(kFanSpeedNames) / sizeof(kFanSpeedNames[0]) ? kFanSpeedNames[value] : kFanSpeedNames[FAN_AUTO];
+}
+
+// Matches a protocol name case-insensitively and without allocating
+bool parseMode(const char* name, Mode* value);
+bool parseFanSpeed(const char* name, FanSpeed* value);
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef Stats_h
+#define Stats_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "settings.h"
+
+enum StatId : uint8_t {
+    STAT_WS_EVENT,
+    STAT_PARSE,
+    STAT_SET_MODE,
+    STAT_SET_FAN_SPEED,
+    STAT_SET_TEMPERATURE,
+    STAT_SET_VERTICAL_SWING,
+    STAT_SET_HORIZONTAL_SWING,
+    STAT_SET_QUIET,
+    STAT_SET_POWERFUL,
+    STAT_IR_SEND,
+    STAT_TO_JSON,
+    STAT_BROADCAST,
+    STAT_SENSOR,
+    STAT_COMMIT,
+    STAT_LOOP,
+    STAT_COMMAND,
+    STAT_COUNT,
+};
+
+// Latency distribution in microseconds. The histogram has two buckets per
+// power of two, so percentiles are accurate to within about 40%, and halves
+// all counts when one of them would overflow so old samples fade out.
+class LatencyStat {
+   public:
+    static const uint8_t kBuckets = 42;
+
+    LatencyStat(void);
+
+    void add(uint32_t us);
+    void reset();
+    uint32_t average() const;
+    uint32_t percentile(uint8_t pct) const;
+
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+
+   private:
+    uint16_t buckets[kBuckets];
+    uint32_t samples;  // sum of the buckets
+
+    static uint8_t bucket(uint32_t us);
+    static uint32_t upperBound(uint8_t bucket);
+};
+
+class Stats {
+   public:
+    Stats(void);
+
+    LatencyStat& get(StatId id);
+    static const char* name(uint8_t id);
+    void sampleHeap();
+    void toJson(JsonObject out);
+
+    uint32_t freeHeap;
+    uint32_t minFreeHeap;
+    uint32_t maxFreeBlock;
+    uint8_t fragmentation;
+    uint8_t maxFragmentation;
+
+   private:
+    LatencyStat latencies[STAT_COUNT];
+};
+
+extern Stats stats;
+
+// Times the rest of the enclosing scope
+class StatTimer {
+   public:
+    explicit StatTimer(LatencyStat& stat) : stat(stat), started(micros()) {}
+    ~StatTimer() {
+        stat.add(micros() - started);
+    }
+
+   private:
+    LatencyStat& stat;
+    uint32_t started;
+};
+
+#if STATS_ENABLED
+#define STATS_CONCAT_(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_(a, b)
+#define STATS_TIME(id) StatTimer STATS_CONCAT(statTimer, __LINE__)(stats.get(id))
+#else
+#define STATS_TIME(id)
+#endif
+
+#endif
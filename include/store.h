@@ -0,0 +1,59 @@
+#ifndef Store_h
+#define Store_h
+
+#include <Arduino.h>
+
+#include "settings.h"
+
+// Persists one fixed-size record as a log in the flash sector that EEPROM
+// used to occupy.
+//
+// Every write appends a new copy of the record to the next erased slot, and
+// the sector is only erased once all slots are used, so an erase happens
+// once every STORE_SLOTS writes instead of on every commit. Writes are
+// staged in RAM and flushed at most once every STORE_INTERVAL_MS.
+class Store {
+   public:
+    struct Header {
+        uint16_t magic;
+        uint8_t version;
+        uint8_t length;
+        uint32_t sequence;
+        uint32_t crc;
+    };
+
+    static const size_t kSectorSize = 4096;
+    static const size_t kSlotSize = STORE_SLOT_SIZE;
+    static const size_t kSlots = kSectorSize / kSlotSize;
+    static const size_t kMaxLength = kSlotSize - sizeof(Header);
+
+    Store(uint8_t version, size_t length);
+
+    bool begin(void* data);
+    bool readLegacy(uint32_t offset, uint8_t* data, size_t length);
+    void write(const void* data);
+    void loop(bool busy);
+    void flush();
+    bool pending() const;
+
+    unsigned long commits;
+    unsigned long erases;
+
+   private:
+    uint8_t version;
+    uint8_t length;
+    uint32_t address;
+    uint32_t sequence;
+    uint16_t next;
+    bool dirty;
+    unsigned long lastFlush;
+
+    // staged record, flash writes need 4 byte alignment
+    uint32_t slot[kSlotSize / 4];
+
+    static uint32_t crc32(const uint8_t* data, size_t length);
+    bool readSlot(uint16_t index, uint32_t* out);
+    bool erased(uint16_t index);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef Thermostat_h
+#define Thermostat_h
+
+#include <Arduino.h>
+
+#include "settings.h"
+#include "state.h"
+
+// On-device control loop for one zone, turned on with {"thermostat":true}.
+//
+// Clients keep setting the mode, fan speed and target temperature as
+// before, Ac passes the mode and fan speed they set on as wantedMode and
+// wantedFanSpeed. In cool, heat and auto it compares the filtered room
+// temperature with the target. Once the room is more than
+// THERMOSTAT_HYSTERESIS past the target the unit idles in fan mode at the
+// lowest speed, and it runs again once the room is more than
+// THERMOSTAT_HYSTERESIS short of it. More than THERMOSTAT_BOOST short, an
+// automatic fan runs at full speed. The compressor stays on for
+// THERMOSTAT_MIN_ON_MS and off for THERMOSTAT_MIN_OFF_MS at least. Other
+// modes and stale readings pass through unchanged, once the minimum off
+// time is over.
+class Thermostat {
+   public:
+    enum Demand : uint8_t {
+        IDLE,   // target reached, fan only
+        RUN,    // what the clients asked for
+        BOOST,  // far off the target, full fan
+    };
+
+    Thermostat(void);
+
+    void enable(const AcState& state);
+    void disable();
+    bool decide(const AcState& state, float temperature, unsigned long now, Mode& mode, FanSpeed& fanSpeed);
+
+    bool enabled;
+    Demand demand;
+    Mode wantedMode;  // as the clients set them
+    FanSpeed wantedFanSpeed;
+    unsigned long cycles;  // compressor starts
+
+   private:
+    Mode direction;  // cooling or heating while running in auto
+    unsigned long changedAt;
+
+    static bool controls(Mode mode);
+    static bool compresses(Mode mode);
+};
+
+constexpr const char* kDemandNames[] = {"idle", "run", "boost"};
+
+inline const char* demandName(Thermostat::Demand value) {
+    return kDemandNames[value];
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef Zone_h
+#define Zone_h
+
+#include <Arduino.h>
+
+#include "backend.h"
+#include "settings.h"
+#include "state.h"
+
+// State Fields
+#define F_CURRENT_TEMPERATURE (1 << 0)
+#define F_CURRENT_HUMIDITY (1 << 1)
+#define F_TARGET_MODE (1 << 2)
+#define F_TARGET_FAN_SPEED (1 << 3)
+#define F_TARGET_TEMPERATURE (1 << 4)
+#define F_VERTICAL_SWING (1 << 5)
+#define F_HORIZONTAL_SWING (1 << 6)
+#define F_QUIET_MODE (1 << 7)
+#define F_POWERFUL_MODE (1 << 8)
+#define F_ALL 0x1FF
+#define F_COUNT 9
+
+// Zones the store keeps room for, changing it moves everything stored after
+// the zone states
+#define ZONE_MAX 4
+
+#define ZONE_ONE(backend, pin, topic) +1
+#define ZONE_COUNT (0 ZONES(ZONE_ONE))
+
+static_assert(ZONE_COUNT >= 1 && ZONE_COUNT <= ZONE_MAX, "ZONES must list 1 to ZONE_MAX zones");
+
+// One indoor unit: its emitter, protocol, state and what its clients have
+// seen. Zones only queue frames, Ac sends them one at a time as they all
+// share the IR transmitter.
+class Zone {
+   public:
+    Zone(const char* topic, uint8_t pin, IrBackend& backend);
+
+    const char* topic;  // clients connect to ws://host:81/<topic>
+    uint8_t pin;
+    IrBackend& backend;
+    AcState state;
+
+    unsigned long lastCommand;
+    unsigned long modeChangedAt;
+    unsigned long coalesced;
+    unsigned long deduplicated;
+    bool sendPending;
+
+    void begin();
+    void apply();
+    void apply(const AcState& value);
+    void queueSend(bool force);
+    bool ready(unsigned long now) const;
+    unsigned long waited(unsigned long now) const;
+    bool repeats(uint32_t hash);
+    void forget();
+    void remember(uint32_t hash);
+    uint16_t changes(float currentTemperature, float currentHumidity) const;
+    void publish(uint16_t fields, float currentTemperature, float currentHumidity);
+
+    void setTargetMode(Mode value);
+    void setTargetFanSpeed(FanSpeed value);
+    void setTemperature(int value);
+    void setVerticalSwing(bool value);
+    void setHorizontalSwing(bool value);
+    void setQuietMode(bool value);
+    void setPowerfulMode(bool value);
+
+   private:
+    // values as last broadcast to the clients
+    struct {
+        float currentTemperature;
+        float currentHumidity;
+        AcState state;
+    } published;
+
+    bool forceSend;  // a command asked to send even an unchanged frame
+    unsigned long pendingSince;
+
+    // the last frame sent, to skip repeating it
+    uint32_t sentHash;
+    unsigned long sentAt;
+    bool sentAny;
+};
+
+#endif
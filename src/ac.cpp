@@ -1,408 +1,1475 @@
 #include "ac.h"
 
 #include <ArduinoJson.h>
-#include <DHT.h>
-#include <EEPROM.h>
+#include <ESP8266WiFi.h>
 #include <WebSocketsServer.h>
 
+#include "heap.h"
+#include "log.h"
+#include "stats.h"
+
+// shared by everything that sends JSON. The library writes the frame header
+// into the room in front, otherwise it copies short messages into a buffer
+// it allocates for each of them.
+static struct {
+    char header[WEBSOCKETS_MAX_HEADER_SIZE];
+    char payload[JSON_BUFFER_SIZE];
+} outgoing;
+
+// the fields each subscription covers
+#define F_SENSOR (F_CURRENT_TEMPERATURE | F_CURRENT_HUMIDITY)
+#define F_STATE (F_ALL & ~F_SENSOR)
+
+// room for the WebSocket frame header on top of the payload
+#define FRAME_OVERHEAD 8
+
 Ac::Ac() {
     // Default Settings
     currentTemperature = 0;
     currentHumidity = 0;
-    targetMode = "off";
-    targetFanSpeed = "auto";
-    targetTemperature = 23;
-    verticalSwing = true;
-    horizontalSwing = true;
-    quietMode = false;
-    powerfulMode = false;
+    temperatureRate = 0;
+    rateFrom = 0;
+    rateSince = 0;
+    broadcastTask = nullptr;
+    sensorTask = nullptr;
+#if REPLAY_ENABLED
+    replayTask = nullptr;
+#endif
+    latencyMisses = 0;
+    lastCommand = 0;
+    scheduler = nullptr;
+    nextZone = 0;
 }
 
+// Restores the state and gets the IR ready, nothing here needs the network
 void Ac::begin() {
-    EEPROM.begin(512);
+#if LOG_WEBSOCKET
+    logger.addSink(logSink, this);
+#endif
 
-    webSocket.begin();
-    webSocket.onEvent(std::bind(&Ac::webSocketEvent, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+    // only captures `this`, which fits the std::function without allocating
+    webSocket.onEvent([this](uint8_t num, WStype_t type, uint8_t* payload, size_t length) { webSocketEvent(num, type, payload, length); });
 
-    if (mode == DAIKIN) {
-        Serial.println("RUNNING IN DAIKIN MODE");
-        daikin.begin();
-    } else if (mode == PANASONIC) {
-        Serial.println("RUNNING IN PANASONIC MODE");
-        panasonic.begin();
-        panasonic.setModel(kPanasonicRkr);
+    for (Zone& zone : zones) {
+        zone.begin();
     }
+#if IR_ASYNC
+    irTransmitter.begin();
+#endif
+#if IR_RECV
+    irReceiver.begin();
+#endif
 
     // restore settings
     restore();
 
-    // start DHT
-    dht.begin();
+    // start DHT, the first sample is taken from loop()
+    sensor.begin();
+
+    // NTP sets the clock for the program once there is a network
+    program.begin();
+}
+
+// Accepts WebSocket clients, call once there is an IP
+void Ac::serve() {
+    webSocket.begin();
+#if GROUP_ENABLED
+    group.begin();
+#endif
+}
+
+// Registers the main loop work with the scheduler
+void Ac::schedule(Scheduler& scheduler) {
+    this->scheduler = &scheduler;
 
-    // load initial weather
-    this->getWeather();
+    // the library allocates per connection and message, webSocketEvent()
+    // checks its own part
+    scheduler.allowHeap(scheduler.add("websocket", [](void* ac) { ((Ac*)ac)->webSocket.loop(); }, this, POLL_MS, TASK_BUDGET_IO_US, Scheduler::IO));
+    scheduler.add("clients", [](void* ac) { ((Ac*)ac)->deliver(); }, this, POLL_MS, TASK_BUDGET_IO_US, Scheduler::IO);
+    scheduler.add("send", [](void* ac) { ((Ac*)ac)->sendIfQuiet(); }, this, POLL_MS, TASK_BUDGET_SEND_US, Scheduler::IO);
+    sensorTask = scheduler.add("sensor", [](void* ac) { ((Ac*)ac)->sample(); }, this, POLL_MS, SENSOR_BUDGET_US);
+    broadcastTask = scheduler.add("broadcast", [](void* ac) { ((Ac*)ac)->broadcast(); }, this, BROADCAST_INTERVAL_MS, TASK_BUDGET_BROADCAST_US);
+    scheduler.add("stats", [](void* ac) { ((Ac*)ac)->pushStats(); }, this, STATS_PUSH_MS, TASK_BUDGET_BROADCAST_US);
+    scheduler.add("store", [](void* ac) { ((Ac*)ac)->store.loop(((Ac*)ac)->busy()); }, this, STORE_POLL_MS, TASK_BUDGET_STORE_US);
+    scheduler.add("program", [](void* ac) { ((Ac*)ac)->runProgram(); }, this, PROGRAM_POLL_MS, TASK_BUDGET_BROADCAST_US);
+#if GROUP_ENABLED
+    scheduler.add("group", [](void* ac) { ((Ac*)ac)->receiveGroup(); }, this, POLL_MS, TASK_BUDGET_IO_US, Scheduler::IO);
+#endif
+#if IR_RECV
+    scheduler.add("irrecv", [](void* ac) { ((Ac*)ac)->receive(); }, this, POLL_MS, TASK_BUDGET_IO_US, Scheduler::IO);
+#endif
+#if REPLAY_ENABLED
+    replayTask = scheduler.add("replay", [](void* ac) { ((Ac*)ac)->replayTick(); }, this, replay.period(), TASK_BUDGET_IO_US);
+#endif
 }
 
-void Ac::loop() {
-    webSocket.loop();
+// True while commands are coming in or an IR send is pending, background
+// work such as sampling and flash writes holds off until then
+bool Ac::busy() {
+    for (const Zone& zone : zones) {
+        if (zone.sendPending) {
+            return true;
+        }
+    }
+
+    return irTransmitter.busy() || millis() - lastCommand < SENSOR_QUIET_MS;
+}
 
+// Sends once a burst of commands is over. Zones take turns, so one frame
+// plays at a time and a busy zone cannot starve the others.
+void Ac::sendIfQuiet() {
     unsigned long currentMillis = millis();
 
-    if (currentMillis - loopLastRun >= 30000) {
-        loopLastRun = currentMillis;
+    // flash LED OFF once the frame is out
+    if (irTransmitter.finished()) {
+        digitalWrite(LED_BUILTIN, HIGH);
+    }
+
+    // the previous frame still plays, or its gap has not passed yet
+    if (irTransmitter.busy()) {
+        return;
+    }
+#if IR_RECV
+    irReceiver.resume();
+#endif
+
+    for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+        uint8_t index = (nextZone + i) % ZONE_COUNT;
+        if (zones[index].ready(currentMillis)) {
+            nextZone = (index + 1) % ZONE_COUNT;
+            this->send(zones[index]);
+            return;
+        }
+    }
+}
+
+void Ac::sample() {
+    STATS_TIME(STAT_SENSOR);
+    sensor.loop(busy());
+    if (sensor.available()) {
         this->getWeather();
-        this->broadcast();
+        history.add(currentTemperature, currentHumidity);
+#if THERMOSTAT_ENABLED
+        for (Zone& zone : zones) {
+            if (control(zone)) {
+                zone.queueSend(false);
+            }
+        }
+#endif
+
+        // over a fixed window, between two samples a single step of the
+        // sensor would count as moving at any interval
+        unsigned long now = millis();
+        if (!rateSince) {
+            rateFrom = currentTemperature;
+            rateSince = now;
+        } else if (now - rateSince >= SENSOR_RATE_MS) {
+            temperatureRate = (currentTemperature - rateFrom) * 60000 / (now - rateSince);
+            rateFrom = currentTemperature;
+            rateSince = now;
+        }
+    }
+    if (sensor.missed()) {
+        history.addMissing();
+    }
+
+#if SENSOR_ADAPTIVE
+    adapt();
+#endif
+
+    // the start pulse and capture are timed by polling, so no sleeping then
+    if (scheduler != nullptr) {
+        scheduler->setPeriod(sensorTask, sensor.phase == Sensor::IDLE ? POLL_MS : 0);
+    }
+}
+
+// Fast right after a mode change and while the temperature moves, slow when
+// every zone is off and the room is steady
+uint32_t Ac::sampleInterval() {
+    unsigned long now = millis();
+    bool running = false;
+
+    for (const Zone& zone : zones) {
+        if (now - zone.modeChangedAt < SENSOR_ACTIVE_MS) {
+            return SENSOR_FAST_MS;
+        }
+        if (zone.state.mode != MODE_OFF) {
+            running = true;
+        }
+    }
+
+    if (fabs(temperatureRate) >= SENSOR_FAST_RATE) {
+        return SENSOR_FAST_MS;
+    }
+
+    return running ? SENSOR_INTERVAL_MS : SENSOR_IDLE_MS;
+}
+
+// Applies the sample interval to the sensor and the periodic broadcast
+void Ac::adapt() {
+    uint32_t interval = sampleInterval();
+
+    sensor.setInterval(interval);
+    if (scheduler != nullptr) {
+        scheduler->setPeriod(broadcastTask, interval);
     }
 }
 
 void Ac::webSocketEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
+    STATS_TIME(STAT_WS_EVENT);
+    // the websocket task may allocate, the library does before calling this
+    uint32_t allocations = heapAllocations();
+
     switch (type) {
         case WStype_DISCONNECTED:
-            Serial.printf("[%u] Disconnected!\r\n", num);
+            LOG_INFO("[%u] Disconnected!", num);
+#if REPLAY_ENABLED
+            if (replay.active && replay.client == num) {
+                stopReplay();
+            }
+            if (replay.client == num) {
+                replay.reportPending = false;
+            }
+#endif
+            clients[num].reset(0);
             break;
         case WStype_CONNECTED: {
-            Serial.printf("[%u] Connected from url: %s\r\n", num, payload);
-            // broadcast current settings
-            this->broadcast();
+            LOG_INFO("[%u] Connected from url: %s", num, payload);
+            // the path picks the zone, the first zone also takes "/"
+            Zone* zone = findZone((const char*)payload + 1);
+            if (zone == nullptr) {
+                LOG_WARN("[%u] No zone %s, using %s", num, payload, zones[0].topic);
+                zone = &zones[0];
+            }
+            Client& client = clients[num];
+            client.reset(zone - zones);
+            client.connected = true;
+
+            // send current settings
+            client.update(F_ALL);
+            deliver(num);
             break;
         }
         case WStype_TEXT: {
             // send the payload to the ac handler
-            this->incomingRequest((char*)&payload[0]);
+            this->incomingRequest(num, (char*)payload, length);
+            break;
+        }
+        case WStype_BIN: {
+            this->incomingBinary(num, payload, length);
             break;
         }
         case WStype_PING:
-            // Serial.printf("[%u] Got Ping!\r\n", num);
+            // LOG_DEBUG("[%u] Got Ping!", num);
             break;
         case WStype_PONG:
-            // Serial.printf("[%u] Got Pong!\r\n", num);
+            // LOG_DEBUG("[%u] Got Pong!", num);
             break;
         default:
-            Serial.printf("Invalid WStype [%d]\r\n", type);
+            LOG_WARN("Invalid WStype [%d]", type);
             break;
     }
+
+    if (scheduler != nullptr) {
+        scheduler->checkHeap("webSocketEvent", heapAllocations() - allocations);
+    }
 }
 
+// Takes the last good sample through the filters, the sensor reads in the
+// background. Call once per sample.
 void Ac::getWeather() {
-    float humidity = dht.readHumidity();
-    float temp = dht.readTemperature(false);
+    if (!sensor.valid()) {
+        return;
+    }
+
+    currentTemperature = temperatureFilter.add(lroundf(sensor.temperature() * 10)) / 10.0f;
+    currentHumidity = humidityFilter.add(lroundf(sensor.humidity() * 10)) / 10.0f;
+}
 
-    if (isnan(humidity) || isnan(temp)) {
-        Serial.println("Failed to read from DHT sensor!");
+// Sets the sensor offsets from {"temperature":t,"humidity":h}, in degrees
+// and percent, and stores them. They apply from the next sample on.
+void Ac::calibrate(JsonVariant offsets) {
+    if (offsets.containsKey("temperature")) {
+        temperatureFilter.offset = lroundf(offsets["temperature"].as<float>() * 10);
+    }
+    if (offsets.containsKey("humidity")) {
+        humidityFilter.offset = lroundf(offsets["humidity"].as<float>() * 10);
+    }
+
+    LOG_INFO("Calibration: %d / %d tenths", temperatureFilter.offset, humidityFilter.offset);
+    save();
+}
+
+#if THERMOSTAT_ENABLED
+// Hands `zone` to the controller or gives it back with what the clients
+// asked for, and stores the choice
+void Ac::setThermostat(Zone& zone, bool enabled) {
+    Thermostat& thermostat = thermostats[&zone - zones];
+    if (enabled == thermostat.enabled) {
         return;
+    }
+
+    if (enabled) {
+        thermostat.enable(zone.state);
+        control(zone);
     } else {
-        currentTemperature = temp;
-        currentHumidity = humidity;
+        thermostat.disable();
+        zone.setTargetMode(thermostat.wantedMode);
+        zone.setTargetFanSpeed(thermostat.wantedFanSpeed);
     }
+    LOG_INFO("[%s] Thermostat %s", zone.topic, enabled ? "on" : "off");
+    zone.queueSend(false);
+    save();
 }
 
-String Ac::toJson() {
-    DynamicJsonDocument doc(1024);    
+// Lets the controller adjust `zone` to the last reading, returns true if
+// it changed the mode or fan speed
+bool Ac::control(Zone& zone) {
+    Thermostat& thermostat = thermostats[&zone - zones];
+    Thermostat::Demand was = thermostat.demand;
+    bool fresh = sensor.valid() && sensor.age() < THERMOSTAT_STALE_MS;
 
-    doc["currentTemperature"] = currentTemperature;
-    doc["currentHumidity"] = currentHumidity;
-    doc["targetMode"] = targetMode;
-    doc["targetFanSpeed"] = targetFanSpeed;
-    doc["targetTemperature"] = targetTemperature;
-    doc["verticalSwing"] = verticalSwing;
-    doc["horizontalSwing"] = horizontalSwing;
-    doc["quietMode"] = quietMode;
-    doc["powerfulMode"] = powerfulMode;
+    Mode mode;
+    FanSpeed fanSpeed;
+    if (!thermostat.decide(zone.state, fresh ? currentTemperature : NAN, millis(), mode, fanSpeed)) {
+        return false;
+    }
 
-    String res;
-    serializeJson(doc, res);
+    if (thermostat.demand != was) {
+        LOG_INFO("[%s] Thermostat %s at %d tenths", zone.topic, demandName(thermostat.demand), (int)lroundf(currentTemperature * 10));
+    }
 
-    return res;
+    if (mode == zone.state.mode && fanSpeed == zone.state.fanSpeed) {
+        return false;
+    }
+    zone.setTargetMode(mode);
+    zone.setTargetFanSpeed(fanSpeed);
+    return true;
 }
+#endif
 
-void Ac::broadcast() {
-    String res = toJson();
-    webSocket.broadcastTXT(res);
-}
+// Replaces the program of `zone` with `entries` and stores it. Invalid
+// entries and those that do not fit are dropped.
+void Ac::setProgram(uint8_t zone, JsonArray entries) {
+    ProgramEntry* slot = saved.program;
+    ProgramEntry* end = saved.program + PROGRAM_ENTRIES;
 
-void Ac::incomingRequest(String payload) {
-    Serial.println(payload);
-    DynamicJsonDocument doc(1024);
-    deserializeJson(doc, payload);
+    // keep the other zones' entries, packed at the front
+    for (const ProgramEntry* entry = saved.program; entry < end; entry++) {
+        if (entry->days && entry->zone != zone) {
+            *slot++ = *entry;
+        }
+    }
 
-    /* Get and Set Target State */
-    if (doc.containsKey("targetMode")) {
-        setTargetMode(doc["targetMode"]);
+    uint8_t dropped = 0;
+    for (JsonVariant value : entries) {
+        if (slot < end && Program::parse(value, zone, *slot)) {
+            slot++;
+        } else {
+            dropped++;
+        }
     }
 
-    /* Get and Set Fan Speed */
-    if (doc.containsKey("targetFanSpeed")) {
-        setTargetFanSpeed(doc["targetFanSpeed"]);
+    while (slot < end) {
+        memset(slot++, 0, sizeof(ProgramEntry));
     }
 
-    /* Get and Set Target Temperature */
-    if (doc.containsKey("targetTemperature")) {
-        setTemperature(doc["targetTemperature"]);
+    if (dropped) {
+        LOG_WARN("[%s] %u program entries dropped", zones[zone].topic, dropped);
     }
+    save();
+}
 
-    /* Other Settings */
-    if (doc.containsKey("verticalSwing")) {
-        setVerticalSwing(doc["verticalSwing"]);
+// Serializes the program of `zone` into `out`
+size_t Ac::programJson(uint8_t zone, char* out, size_t size) {
+    StaticJsonDocument<PROGRAM_DOC_SIZE> doc;
+    JsonArray list = doc.createNestedArray("program");
+    for (const ProgramEntry& entry : saved.program) {
+        if (entry.days && entry.zone == zone) {
+            Program::toJson(entry, list.createNestedObject());
+        }
+    }
+    return serializeJson(doc, out, size);
+}
+
+// Applies the entries due since the last run, the task runs every
+// PROGRAM_POLL_MS
+void Ac::runProgram() {
+    uint16_t minute;
+    while (program.tick(minute)) {
+        for (const ProgramEntry& entry : saved.program) {
+            if (entry.zone < ZONE_COUNT && Program::matches(entry, minute)) {
+                apply(entry);
+            }
+        }
     }
+}
+
+// A program entry goes the way of a command
+void Ac::apply(const ProgramEntry& entry) {
+    Zone& zone = zones[entry.zone];
+    LOG_INFO("[%s] Program %02u:%02u", zone.topic, entry.minute / 60, entry.minute % 60);
 
-    if (doc.containsKey("horizontalSwing")) {
-        setHorizontalSwing(doc["horizontalSwing"]);
+    if (entry.mode != PROGRAM_KEEP) {
+        zone.setTargetMode((Mode)entry.mode);
+#if THERMOSTAT_ENABLED
+        thermostats[entry.zone].wantedMode = (Mode)entry.mode;
+#endif
+    }
+    if (entry.temperature) {
+        zone.setTemperature(entry.temperature);
     }
 
-    if (doc.containsKey("quietMode")) {
-        setQuietMode(doc["quietMode"]);
+    program.runs++;
+    zone.queueSend(false);
+}
+
+// Returns the zone with `topic`, an empty topic is the first zone
+Zone* Ac::findZone(const char* topic) {
+    if (*topic == '\0') {
+        return &zones[0];
     }
 
-    if (doc.containsKey("powerfulMode")) {
-        setPowerfulMode(doc["powerfulMode"]);
+    for (Zone& zone : zones) {
+        if (strcmp(zone.topic, topic) == 0) {
+            return &zone;
+        }
     }
 
-    send();
+    return nullptr;
 }
 
-void Ac::send() {
-    // flash LED ON
-    digitalWrite(LED_BUILTIN, LOW);
+// The mode and fan speed the clients set. Under the thermostat the zone
+// switches between those and idling, which clients must not see as their
+// target, or they would send it back as a new one.
+Mode Ac::targetMode(const Zone& zone) {
+#if THERMOSTAT_ENABLED
+    const Thermostat& thermostat = thermostats[&zone - zones];
+    if (thermostat.enabled) {
+        return thermostat.wantedMode;
+    }
+#endif
+    return zone.state.mode;
+}
 
-    // send the IR signal
-    if (mode == DAIKIN) {
-#if SEND_DAIKIN
-        daikin.send();
-#endif  // SEND_DAIKIN
-    } else if (mode == PANASONIC) {
-#if SEND_PANASONIC_AC
-        Serial.println(panasonic.toString());
-        panasonic.send();
-#endif  // SEND_PANASONIC_AC
+FanSpeed Ac::targetFanSpeed(const Zone& zone) {
+#if THERMOSTAT_ENABLED
+    const Thermostat& thermostat = thermostats[&zone - zones];
+    if (thermostat.enabled) {
+        return thermostat.wantedFanSpeed;
     }
+#endif
+    return zone.state.fanSpeed;
+}
 
-    // flash LED OFF
-    digitalWrite(LED_BUILTIN, HIGH);
+// Serializes the given fields of `zone` into `out`, returns the length written
+size_t Ac::toJson(const Zone& zone, char* out, size_t size, uint16_t fields) {
+    STATS_TIME(STAT_TO_JSON);
+    StaticJsonDocument<JSON_OBJECT_SIZE(9)> doc;
 
-    // broadcast update
-    broadcast();
+    if (fields & F_CURRENT_TEMPERATURE) {
+        doc["currentTemperature"] = currentTemperature;
+    }
+    if (fields & F_CURRENT_HUMIDITY) {
+        doc["currentHumidity"] = currentHumidity;
+    }
+    if (fields & F_TARGET_MODE) {
+        doc["targetMode"] = modeName(targetMode(zone));
+    }
+    if (fields & F_TARGET_FAN_SPEED) {
+        doc["targetFanSpeed"] = fanSpeedName(targetFanSpeed(zone));
+    }
+    if (fields & F_TARGET_TEMPERATURE) {
+        doc["targetTemperature"] = zone.state.temperature;
+    }
+    if (fields & F_VERTICAL_SWING) {
+        doc["verticalSwing"] = zone.state.verticalSwing();
+    }
+    if (fields & F_HORIZONTAL_SWING) {
+        doc["horizontalSwing"] = zone.state.horizontalSwing();
+    }
+    if (fields & F_QUIET_MODE) {
+        doc["quietMode"] = zone.state.quiet;
+    }
+    if (fields & F_POWERFUL_MODE) {
+        doc["powerfulMode"] = zone.state.powerful;
+    }
 
-    // save
-    save();
+    return serializeJson(doc, out, size);
 }
 
-void Ac::setTargetMode(String value) {
-    value.toLowerCase();
-
-    if (value == "off") {
-        if (mode == DAIKIN) {
-            daikin.off();
-        } else if (mode == PANASONIC) {
-            panasonic.off();
-        }
-    } else if (value == "cool") {
-        if (mode == DAIKIN) {
-            daikin.on();
-            daikin.setMode(DAIKIN_COOL);
-        } else if (mode == PANASONIC) {
-            panasonic.on();
-            panasonic.setMode(kPanasonicAcCool);
-        }
-    } else if (value == "heat") {
-        if (mode == DAIKIN) {
-            daikin.on();
-            daikin.setMode(DAIKIN_HEAT);
-        } else if (mode == PANASONIC) {
-            panasonic.on();
-            panasonic.setMode(kPanasonicAcHeat);
-        }
-    } else if (value == "fan") {
-        if (mode == DAIKIN) {
-            daikin.on();
-            daikin.setMode(DAIKIN_FAN);
-        } else if (mode == PANASONIC) {
-            panasonic.on();
-            panasonic.setMode(kPanasonicAcFan);
-        }
-    } else if (value == "auto") {
-        if (mode == DAIKIN) {
-            daikin.on();
-            daikin.setMode(DAIKIN_AUTO);
-        } else if (mode == PANASONIC) {
-            panasonic.on();
-            panasonic.setMode(kPanasonicAcAuto);
-        }
-    } else if (value == "dry") {
-        if (mode == DAIKIN) {
-            daikin.on();
-            daikin.setMode(DAIKIN_DRY);
-        } else if (mode == PANASONIC) {
-            panasonic.on();
-            panasonic.setMode(kPanasonicAcDry);
+// Serializes the given fields of `zone` as a binary state message
+size_t Ac::toMsgPack(const Zone& zone, char* out, size_t size, uint16_t fields) {
+    STATS_TIME(STAT_TO_JSON);
+    StaticJsonDocument<JSON_ARRAY_SIZE(10)> doc;
+    JsonArray message = doc.to<JsonArray>();
+
+    message.add((uint8_t)MSG_STATE);
+    for (uint8_t bit = 0; bit < F_COUNT; bit++) {
+        JsonVariant value = message.add();
+        if (!(fields & (1 << bit))) {
+            continue;
         }
+
+        switch (1 << bit) {
+            case F_CURRENT_TEMPERATURE:
+                value.set(currentTemperature);
+                break;
+            case F_CURRENT_HUMIDITY:
+                value.set(currentHumidity);
+                break;
+            case F_TARGET_MODE:
+                value.set((uint8_t)targetMode(zone));
+                break;
+            case F_TARGET_FAN_SPEED:
+                value.set((uint8_t)targetFanSpeed(zone));
+                break;
+            case F_TARGET_TEMPERATURE:
+                value.set(zone.state.temperature);
+                break;
+            case F_VERTICAL_SWING:
+                value.set(zone.state.verticalSwing());
+                break;
+            case F_HORIZONTAL_SWING:
+                value.set(zone.state.horizontalSwing());
+                break;
+            case F_QUIET_MODE:
+                value.set(zone.state.quiet);
+                break;
+            case F_POWERFUL_MODE:
+                value.set(zone.state.powerful);
+                break;
+        }
+    }
+
+    return serializeMsgPack(doc, out, size);
+}
+
+// Sends the message in `outgoing` to client `num` if the `room` left in its
+// send buffer takes it, returns false to try again once there is more. A
+// message longer than even an empty buffer takes is written blocking
+// instead, waiting for room would hold up everything queued behind it for
+// good.
+bool Ac::sendTo(uint8_t num, size_t length, bool binary, size_t& room) {
+    bool blocking = length + FRAME_OVERHEAD > WebSocketServer::kSendBuffer;
+    if (!blocking && length + FRAME_OVERHEAD > room) {
+        return false;
+    }
+
+    if (binary) {
+        webSocket.sendBIN(num, (uint8_t*)outgoing.payload, length, true);
     } else {
-        Serial.println("WARNING: No Valid Mode Passed. Turning Off.");
-        if (mode == DAIKIN) {
-            daikin.off();
-            value = "off";
-        } else if (mode == PANASONIC) {
-            panasonic.off();
-            value = "off";
+        webSocket.sendTXT(num, outgoing.payload, length, true);
+    }
+    clients[num].sent++;
+
+    room = blocking ? webSocket.writable(num) : room - length - FRAME_OVERHEAD;
+    return true;
+}
+
+// Broadcasts every zone that changed since its last broadcast
+void Ac::broadcast(bool force) {
+    for (Zone& zone : zones) {
+        broadcast(zone, force);
+    }
+}
+
+// Queues everything the clients subscribed to, e.g. after they may have
+// missed updates while the link was down
+void Ac::resync() {
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        Client& client = clients[num];
+        if (client.connected) {
+            client.update(subscribed(client));
+        }
+    }
+    deliver();
+}
+
+// The state fields `client` subscribed to
+uint16_t Ac::subscribed(const Client& client) {
+    uint16_t fields = 0;
+    if (client.subscriptions & SUB_STATE) {
+        fields |= F_STATE;
+    }
+    if (client.subscriptions & SUB_SENSOR) {
+        fields |= F_SENSOR;
+    }
+    return fields;
+}
+
+// Sends whatever client `num` has waiting, as far as its TCP buffer takes it
+// without blocking
+void Ac::deliver(uint8_t num) {
+    Client& client = clients[num];
+    if (!client.connected) {
+        return;
+    }
+
+    size_t room = webSocket.writable(num);
+    if (room <= FRAME_OVERHEAD) {
+        return;
+    }
+
+    if (client.fields) {
+        const Zone& zone = zones[client.zone];
+        size_t length = client.binary ? toMsgPack(zone, outgoing.payload, sizeof(outgoing.payload), client.fields) : toJson(zone, outgoing.payload, sizeof(outgoing.payload), client.fields);
+        if (!sendTo(num, length, client.binary, room)) {
+            return;
+        }
+        client.fields = 0;
+#if REPLAY_ENABLED
+        // acknowledges the replayed commands once they were handled
+        if (replay.active && replay.client == num && !zone.sendPending) {
+            replay.acknowledged();
+        }
+#endif
+    }
+
+    if (client.statsPending) {
+        size_t length = statsJson(outgoing.payload, sizeof(outgoing.payload), client.binary);
+        if (!sendTo(num, length, client.binary, room)) {
+            return;
+        }
+        client.statsPending = false;
+    }
+
+    // sent as text like the history
+    if (client.programPending) {
+        size_t length = programJson(client.zone, outgoing.payload, sizeof(outgoing.payload));
+        if (!sendTo(num, length, false, room)) {
+            return;
+        }
+        client.programPending = false;
+    }
+
+#if REPLAY_ENABLED
+    if (replay.reportPending && replay.client == num) {
+        StaticJsonDocument<REPLAY_DOC_SIZE> doc;
+        replay.toJson(doc.createNestedObject("replay"));
+        size_t length = client.binary ? serializeMsgPack(doc, outgoing.payload, sizeof(outgoing.payload)) : serializeJson(doc, outgoing.payload, sizeof(outgoing.payload));
+        if (!sendTo(num, length, client.binary, room)) {
+            return;
+        }
+        replay.reportPending = false;
+    }
+#endif
+
+    // the history goes out as text, in as many frames as it takes
+    while (client.historySeries < History::SERIES_COUNT && room > FRAME_OVERHEAD) {
+        size_t size = room - FRAME_OVERHEAD < sizeof(outgoing.payload) ? room - FRAME_OVERHEAD : sizeof(outgoing.payload);
+        uint32_t cursor = client.historyCursor;
+        size_t length = history.toJson((History::Series)client.historySeries, cursor, outgoing.payload, size);
+        if (!length || !sendTo(num, length, false, room)) {
+            return;
+        }
+
+        client.historyCursor = cursor;
+        if (cursor == UINT32_MAX) {
+            client.historySeries++;
+            client.historyCursor = 0;
         }
     }
 
-    if (value != targetMode) {
-        Serial.print("Target Mode Changed: ");
-        Serial.println(value);
-        targetMode = value;
+    size_t length;
+    while ((length = client.peek(outgoing.payload, sizeof(outgoing.payload))) && sendTo(num, length, client.binary, room)) {
+        client.pop();
     }
 }
 
-void Ac::setTargetFanSpeed(String value) {
-    value.toLowerCase();
+void Ac::deliver() {
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        deliver(num);
+    }
+}
 
-    if (value == "auto") {
-        if (mode == DAIKIN) {
-            daikin.setFan(DAIKIN_FAN_AUTO);
-        } else if (mode == PANASONIC) {
-            panasonic.setFan(kPanasonicAcFanAuto);
+// Queues the stats for the clients that subscribed to them
+void Ac::pushStats() {
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        Client& client = clients[num];
+        if (client.connected && client.subscriptions & SUB_STATS) {
+            if (client.statsPending) {
+                client.coalesced++;
+            }
+            client.statsPending = true;
         }
-    } else if (value == "min") {
-        if (mode == DAIKIN) {
-            daikin.setFan(DAIKIN_FAN_MIN);
-        } else if (mode == PANASONIC) {
-            panasonic.setFan(kPanasonicAcFanMin);
+    }
+}
+
+// Broadcasts the state of `zone` to its clients if anything changed since
+// the last broadcast. With `force` the state is sent even if nothing
+// changed, e.g. to ack a command.
+void Ac::broadcast(Zone& zone, bool force) {
+    STATS_TIME(STAT_BROADCAST);
+    uint16_t fields = zone.changes(currentTemperature, currentHumidity);
+
+    if (!fields) {
+        if (!force) {
+            return;
         }
-    } else if (value == "max") {
-        if (mode == DAIKIN) {
-            daikin.setFan(DAIKIN_FAN_MAX);
-        } else if (mode == PANASONIC) {
-            panasonic.setFan(kPanasonicAcFanMax);
+        fields = F_ALL;
+    }
+
+    if (!BROADCAST_DELTA) {
+        fields = F_ALL;
+    }
+
+    // queued per client, a slow one only delays itself
+    uint8_t index = &zone - zones;
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        Client& client = clients[num];
+        if (client.connected && client.zone == index) {
+            client.update(fields & subscribed(client));
+            deliver(num);
         }
+    }
+    zone.publish(fields, currentTemperature, currentHumidity);
+}
+
+// Parses a message from client `num` in place, the document only points
+// into `payload`
+void Ac::incomingRequest(uint8_t num, char* payload, size_t length) {
+    LOG_DEBUG("[%u] %.*s", num, (int)length, payload);
+
+    StaticJsonDocument<COMMAND_DOC_SIZE> doc;
+    DeserializationError err;
+    {
+        STATS_TIME(STAT_PARSE);
+        err = deserializeJson(doc, payload, length);
+    }
+    if (err) {
+        LOG_WARN("Invalid Command: %s", err.c_str());
+        return;
+    }
+
+    /* Queries */
+    Client& client = clients[num];
+
+    if (doc.containsKey("stats")) {
+        client.statsPending = true;
+        deliver(num);
+        return;
+    }
+
+    if (doc.containsKey("log")) {
+        if (doc["log"]) {
+            client.subscriptions |= SUB_LOG;
+        } else {
+            client.subscriptions &= ~SUB_LOG;
+        }
+        return;
+    }
+
+    if (doc.containsKey("history")) {
+        client.requestHistory();
+        deliver(num);
+        return;
+    }
+
+    if (doc.containsKey("calibrate")) {
+        calibrate(doc["calibrate"]);
+        return;
+    }
+
+    if (doc.containsKey("binary")) {
+        client.setBinary(doc["binary"]);
+        return;
+    }
+
+    if (doc.containsKey("program")) {
+        JsonVariant entries = doc["program"];
+        if (entries.is<JsonArray>()) {
+            setProgram(client.zone, entries.as<JsonArray>());
+        }
+        client.programPending = true;
+        deliver(num);
+        return;
+    }
+
+#if THERMOSTAT_ENABLED
+    if (doc.containsKey("thermostat")) {
+        setThermostat(zones[client.zone], doc["thermostat"]);
+        return;
+    }
+#endif
+
+#if REPLAY_ENABLED
+    if (doc.containsKey("replay")) {
+        JsonVariant options = doc["replay"];
+        if (options.is<JsonObject>() || options.as<bool>()) {
+            startReplay(num, options);
+        } else {
+            stopReplay();
+        }
+        return;
+    }
+#endif
+
+    if (doc.containsKey("subscribe")) {
+        client.subscriptions = 0;
+        for (JsonVariant name : doc["subscribe"].as<JsonArray>()) {
+            client.subscriptions |= parseSubscription(name.as<const char*>());
+        }
+        return;
+    }
+
+    lastCommand = millis();
+    setState(zones[client.zone], doc.as<JsonVariant>());
+}
+
+// Applies the target state fields of a command to `zone`
+void Ac::setState(Zone& zone, JsonVariant command) {
+#if THERMOSTAT_ENABLED
+    Thermostat& thermostat = thermostats[&zone - zones];
+#endif
+
+    /* Get and Set Target State */
+    if (command.containsKey("targetMode")) {
+        Mode value;
+        if (!parseMode(command["targetMode"], &value)) {
+            LOG_WARN("No Valid Mode Passed. Turning Off.");
+            value = MODE_OFF;
+        }
+        zone.setTargetMode(value);
+#if THERMOSTAT_ENABLED
+        thermostat.wantedMode = value;
+#endif
+    }
+
+    /* Get and Set Fan Speed */
+    if (command.containsKey("targetFanSpeed")) {
+        FanSpeed value;
+        if (!parseFanSpeed(command["targetFanSpeed"], &value)) {
+            LOG_WARN("No Valid Fan Speed Passed. Setting to Auto.");
+            value = FAN_AUTO;
+        }
+        zone.setTargetFanSpeed(value);
+#if THERMOSTAT_ENABLED
+        thermostat.wantedFanSpeed = value;
+#endif
+    }
+
+    /* Get and Set Target Temperature */
+    if (command.containsKey("targetTemperature")) {
+        zone.setTemperature(command["targetTemperature"]);
+    }
+
+    /* Other Settings */
+    if (command.containsKey("verticalSwing")) {
+        zone.setVerticalSwing(command["verticalSwing"]);
+    }
+
+    if (command.containsKey("horizontalSwing")) {
+        zone.setHorizontalSwing(command["horizontalSwing"]);
+    }
+
+    if (command.containsKey("quietMode")) {
+        zone.setQuietMode(command["quietMode"]);
+    }
+
+    if (command.containsKey("powerfulMode")) {
+        zone.setPowerfulMode(command["powerfulMode"]);
+    }
+
+    zone.queueSend(command["force"]);
+}
+
+#if GROUP_ENABLED
+// Applies a command sent to the group to the zone it names with "zone", or
+// to every zone, and acknowledges it
+void Ac::receiveGroup() {
+    size_t length;
+    char* payload = group.read(length);
+    if (payload == nullptr) {
+        return;
+    }
+    LOG_DEBUG("[group %lu] %.*s", (unsigned long)group.sequence, (int)length, payload);
+
+    StaticJsonDocument<COMMAND_DOC_SIZE> doc;
+    StaticJsonDocument<JSON_OBJECT_SIZE(3)> reply;
+    DeserializationError err = deserializeJson(doc, payload, length);
+    if (err) {
+        LOG_WARN("Invalid Group Command: %s", err.c_str());
+        reply["ok"] = false;
+        reply["error"] = err.c_str();
     } else {
-        if (mode == DAIKIN) {
-            daikin.setFan(DAIKIN_FAN_AUTO);
-        } else if (mode == PANASONIC) {
-            panasonic.setFan(kPanasonicAcFanAuto);
+        const char* topic = doc["zone"] | (const char*)nullptr;
+        uint8_t applied = 0;
+
+        lastCommand = millis();
+        for (Zone& zone : zones) {
+            if (topic == nullptr || strcmp(topic, zone.topic) == 0) {
+                setState(zone, doc.as<JsonVariant>());
+                applied++;
+            }
         }
-        value = "auto";
-        Serial.println("WARNING: No Valid Fan Speed Passed. Setting to Auto.");
+        reply["ok"] = true;
+        reply["zones"] = applied;
     }
 
-    if (value != targetFanSpeed) {
-        Serial.print("Target Fan Speed: ");
-        Serial.println(value);
-        targetFanSpeed = value;
-        // set(S_FAN, targetFanSpeed);
+    // taken even when invalid, so it is not tried again. Committed right
+    // away, a reboot before the deferred commit would let it be replayed.
+    saved.groupSequence = group.sequence;
+    save();
+    store.flush();
+
+    char out[64];
+    group.ack(out, serializeJson(reply, out, sizeof(out)));
+}
+#endif
+
+// Parses a binary message from client `num`, see binary.h
+void Ac::incomingBinary(uint8_t num, uint8_t* payload, size_t length) {
+    StaticJsonDocument<COMMAND_DOC_SIZE> doc;
+    DeserializationError err;
+    {
+        STATS_TIME(STAT_PARSE);
+        err = deserializeMsgPack(doc, (char*)payload, length);
     }
+    if (err) {
+        LOG_WARN("Invalid Command: %s", err.c_str());
+        return;
+    }
+
+    Client& client = clients[num];
+    client.setBinary(true);
+
+    JsonArray message = doc.as<JsonArray>();
+    switch (message[0] | 0xFF) {
+        case MSG_STATS:
+            client.statsPending = true;
+            deliver(num);
+            return;
+        case MSG_HISTORY:
+            client.requestHistory();
+            deliver(num);
+            return;
+        case MSG_SUBSCRIBE:
+            client.subscriptions = message[1] | SUB_DEFAULT;
+            return;
+        case MSG_COMMAND:
+            break;
+        default:
+            LOG_WARN("Invalid binary message from [%u]", num);
+            return;
+    }
+
+    lastCommand = millis();
+    Zone& zone = zones[client.zone];
+
+    // positions follow the F_* bits, see binary.h
+    JsonVariant value = message[1 + 2];
+    if (!value.isNull()) {
+        uint8_t mode = value;
+        zone.setTargetMode(mode < kModeCount ? (Mode)mode : MODE_OFF);
+#if THERMOSTAT_ENABLED
+        thermostats[client.zone].wantedMode = zone.state.mode;
+#endif
+    }
+    value = message[1 + 3];
+    if (!value.isNull()) {
+        uint8_t fanSpeed = value;
+        zone.setTargetFanSpeed(fanSpeed < kFanSpeedCount ? (FanSpeed)fanSpeed : FAN_AUTO);
+#if THERMOSTAT_ENABLED
+        thermostats[client.zone].wantedFanSpeed = zone.state.fanSpeed;
+#endif
+    }
+    value = message[1 + 4];
+    if (!value.isNull()) {
+        zone.setTemperature(value.as<int>());
+    }
+    value = message[1 + 5];
+    if (!value.isNull()) {
+        zone.setVerticalSwing(value.as<bool>());
+    }
+    value = message[1 + 6];
+    if (!value.isNull()) {
+        zone.setHorizontalSwing(value.as<bool>());
+    }
+    value = message[1 + 7];
+    if (!value.isNull()) {
+        zone.setQuietMode(value.as<bool>());
+    }
+    value = message[1 + 8];
+    if (!value.isNull()) {
+        zone.setPowerfulMode(value.as<bool>());
+    }
+
+    zone.queueSend(message[MSG_FORCE] | false);
 }
 
-void Ac::setTemperature(int value) {
-    if (mode == DAIKIN) {
-        daikin.setTemp(value);
-    } else if (mode == PANASONIC) {
-        panasonic.setTemp(value);
+void Ac::send(Zone& zone) {
+#if THERMOSTAT_ENABLED
+    // a new target or mode takes effect with this frame
+    control(zone);
+#endif
+
+    // from the first command of the burst, the time spent asleep before the
+    // command was read does not show here
+    unsigned long latency = zone.waited(millis());
+    if (latency > POWER_LATENCY_MS) {
+        latencyMisses++;
+    }
+#if STATS_ENABLED
+    stats.get(STAT_COMMAND).add(latency * 1000);
+#endif
+
+    // skip a frame the AC already got, idempotent commands would make it beep
+    uint32_t hash = fnv1a(zone.backend.raw(), zone.backend.stateLength());
+    if (zone.repeats(hash)) {
+        LOG_DEBUG("[%s] IR frame unchanged, not sent", zone.topic);
+#if REPLAY_ENABLED
+    } else if (replay.active && !replay.ir) {
+        LOG_DEBUG("[%s] Replaying, IR frame not sent", zone.topic);
+#endif
+    } else {
+        transmit(zone, hash);
     }
-    Serial.print("Target Temperature: ");
-    Serial.println(value);
-    targetTemperature = value;
+
+    // broadcast update, always sent as it acknowledges the command
+    broadcast(zone, true);
+
+    // save
+    save();
 }
 
-void Ac::setVerticalSwing(bool value) {
-    if (mode == DAIKIN) {
-        daikin.setSwingVertical(value);
-    } else if (mode == PANASONIC) {
-        panasonic.setSwingVertical(value ? kPanasonicAcSwingVAuto : kPanasonicAcSwingVHighest);
+void Ac::transmit(Zone& zone, uint32_t hash) {
+    // flash LED ON
+    digitalWrite(LED_BUILTIN, LOW);
+#if IR_RECV
+    // until sendIfQuiet() sees the transmitter idle again
+    irReceiver.pause();
+#endif
+
+    // send the IR signal
+    LOG_DEBUG("%s", zone.backend.toString().c_str());
+#if IR_ASYNC
+    {
+        STATS_TIME(STAT_IR_SEND);
+        IrFrame* frame = frames.find(zone.state, hash);
+        if (frame == nullptr) {
+            frame = frames.insert(zone.state, hash);
+            zone.backend.encode(*frame);
+        }
+        if (!irTransmitter.start(*frame, zone.pin)) {
+            zone.backend.send();
+            digitalWrite(LED_BUILTIN, HIGH);
+        }
     }
-    if (value != verticalSwing) {
-        Serial.print("Verticle Swing: ");
-        Serial.println(value);
-        verticalSwing = value;
-        set(S_VS, (verticalSwing) ? 1 : 0);
+#else
+    {
+        STATS_TIME(STAT_IR_SEND);
+        zone.backend.send();
     }
+
+    // flash LED OFF
+    digitalWrite(LED_BUILTIN, HIGH);
+#endif
 }
 
-void Ac::setHorizontalSwing(bool value) {
-    if (mode == DAIKIN) {
-        daikin.setSwingHorizontal(value);
-    } else if (mode == PANASONIC) {
-        panasonic.setSwingHorizontal(value ? kPanasonicAcSwingHAuto : kPanasonicAcSwingHMiddle);
+#if IR_RECV
+// Takes frames of the AC's own remote into the zone they are for, the first
+// one with that protocol
+void Ac::receive() {
+    decode_results results;
+    if (!irReceiver.read(results)) {
+        return;
     }
-    if (value != horizontalSwing) {
-        Serial.print("Horizontal Swing: ");
-        Serial.println(value);
-        horizontalSwing = value;
-        set(S_HS, (horizontalSwing) ? 1 : 0);
+
+    for (Zone& zone : zones) {
+        AcState state;
+        if (zone.backend.read(results, state)) {
+            received(zone, state);
+            return;
+        }
     }
+
+    LOG_DEBUG("IR frame of protocol %d is for no zone", results.decode_type);
 }
 
-void Ac::setQuietMode(bool value) {
-    if (mode == DAIKIN) {
-        daikin.setQuiet(value);
-    } else if (mode == PANASONIC) {
-        panasonic.setQuiet(value);
+// The remote changed the AC behind our back. The clients get the new state,
+// so they stop re-asserting the old one, and the frame counts as sent, so a
+// command that only repeats it does not make the AC beep.
+void Ac::received(Zone& zone, const AcState& state) {
+    bool changed = state != zone.state;
+
+    zone.apply(state);
+    zone.remember(fnv1a(zone.backend.raw(), zone.backend.stateLength()));
+#if THERMOSTAT_ENABLED
+    Thermostat& thermostat = thermostats[&zone - zones];
+    thermostat.wantedMode = zone.state.mode;
+    thermostat.wantedFanSpeed = zone.state.fanSpeed;
+#endif
+
+    if (!changed) {
+        return;
     }
-    if (value != quietMode) {
-        Serial.print("Quiet Mode: ");
-        Serial.println(value);
-        quietMode = value;
-        set(S_QM, (quietMode) ? 1 : 0);
+
+    LOG_INFO("[%s] Set from the remote", zone.topic);
+    LOG_DEBUG("%s", zone.backend.toString().c_str());
+    broadcast(zone);
+    save();
+}
+#endif
+
+#if REPLAY_ENABLED
+// Replays the trace into the zone of client `num`, from {"rate":r,
+// "count":n,"ir":false}. A replay already running is stopped first.
+void Ac::startReplay(uint8_t num, JsonVariant options) {
+    stopReplay();
+
+    uint8_t index = clients[num].zone;
+    replay.start(num, index, options["rate"] | REPLAY_RATE, options["count"] | 0, options["ir"] | false);
+    replay.saved = zones[index].state;
+    LOG_INFO("[%u] Replaying %u commands at %u/s, IR %s", num, replay.count, replay.rate, replay.ir ? "on" : "off");
+
+    if (scheduler != nullptr) {
+        scheduler->setPeriod(replayTask, replay.period());
+        scheduler->wake(replayTask);
     }
+}
 
-    if (value) {
-        // cannot be powerful and quiet
-        setPowerfulMode(false);
+// Puts the zone back the way it was and queues the results
+void Ac::stopReplay() {
+    if (!replay.active) {
+        return;
     }
+
+    replay.stop();
+    LOG_INFO("Replay done, %u commands, %u acked", replay.issued, replay.acked);
+
+    Zone& zone = zones[replay.zone];
+    zone.state = replay.saved;
+    zone.apply();
+    if (replay.ir) {
+        // the unit got the replayed frames
+        zone.queueSend(false);
+    } else {
+        zone.forget();
+    }
+    broadcast(zone, true);
+    save();
+
+    if (scheduler != nullptr) {
+        scheduler->setPeriod(replayTask, replay.period());
+    }
+    deliver(replay.client);
 }
 
-void Ac::setPowerfulMode(bool value) {
-    if (mode == DAIKIN) {
-        daikin.setPowerful(value);
-    } else if (mode == PANASONIC) {
-        panasonic.setPowerful(value);
+// Feeds the next command of the trace as if client `num` sent it
+void Ac::replayTick() {
+    if (replay.finished()) {
+        stopReplay();
+        return;
     }
-    if (value != powerfulMode) {
-        Serial.print("Powerful Mode: ");
-        Serial.println(value);
-        powerfulMode = value;
-        set(S_PM, (powerfulMode) ? 1 : 0);
+
+    char payload[128];
+    size_t length = replay.next(payload, sizeof(payload));
+    if (length) {
+        incomingRequest(replay.client, payload, length);
     }
+}
+#endif
+
+// Queues a log line for the clients that asked for the log, in one pass
+// per format
+void Ac::logSink(void* context, uint8_t level, const char* line, size_t length) {
+    Ac* ac = (Ac*)context;
+
+    for (uint8_t binary = 0; binary < 2; binary++) {
+        size_t size = 0;
+
+        for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+            Client& client = ac->clients[num];
+            if (!client.connected || !(client.subscriptions & SUB_LOG) || client.binary != binary) {
+                continue;
+            }
 
-    if (value) {
-        // cannot be quiet and powerful
-        setQuietMode(false);
+            if (!size) {
+                StaticJsonDocument<JSON_OBJECT_SIZE(3)> doc;
+                if (binary) {
+                    doc.add((uint8_t)MSG_LOG);
+                    doc.add(level);
+                    doc.add(line);
+                    size = serializeMsgPack(doc, outgoing.payload, sizeof(outgoing.payload));
+                } else {
+                    doc["log"] = line;
+                    doc["level"] = level;
+                    size = serializeJson(doc, outgoing.payload, sizeof(outgoing.payload));
+                }
+            }
+            client.push(outgoing.payload, size);
+        }
     }
 }
 
-// Set a setting value to EEPROM
-void Ac::set(int location, int value) {
-    Serial.printf("Setting %d to %d\n", location, value);
-    EEPROM.write(location, value);
-    dirty = true;
+#if METRICS_ENABLED
+// Everything a scraper wants in the Prometheus text format, the same
+// counters as statsJson() without the per task and per client detail
+void Ac::writeMetrics(MetricsWriter& out) {
+    METRIC_FAMILY(out, "ac_temperature_celsius", "gauge", "Filtered room temperature");
+    out.line(PSTR("ac_temperature_celsius %.2f\n"), currentTemperature);
+    METRIC_FAMILY(out, "ac_humidity_percent", "gauge", "Filtered relative humidity");
+    out.line(PSTR("ac_humidity_percent %.1f\n"), currentHumidity);
+    METRIC_FAMILY(out, "ac_sensor_failures_total", "counter", "Sensor reads that failed");
+    out.line(PSTR("ac_sensor_failures_total %lu\n"), sensor.failures);
+
+    /* AC state */
+    METRIC_FAMILY(out, "ac_target_mode", "gauge", "1 for the mode of the zone");
+    for (const Zone& zone : zones) {
+        for (uint8_t i = 0; i < kModeCount; i++) {
+            out.line(PSTR("ac_target_mode{zone=\"%s\",mode=\"%s\"} %u\n"), zone.topic, modeName((Mode)i), targetMode(zone) == i);
+        }
+    }
+    METRIC_FAMILY(out, "ac_target_fan_speed", "gauge", "1 for the fan speed of the zone");
+    for (const Zone& zone : zones) {
+        for (uint8_t i = 0; i < kFanSpeedCount; i++) {
+            out.line(PSTR("ac_target_fan_speed{zone=\"%s\",speed=\"%s\"} %u\n"), zone.topic, fanSpeedName((FanSpeed)i), targetFanSpeed(zone) == i);
+        }
+    }
+    METRIC_FAMILY(out, "ac_target_temperature_celsius", "gauge", "Target temperature of the zone");
+    for (const Zone& zone : zones) {
+        out.line(PSTR("ac_target_temperature_celsius{zone=\"%s\"} %u\n"), zone.topic, zone.state.temperature);
+    }
+    METRIC_FAMILY(out, "ac_option", "gauge", "Swing, quiet and powerful mode of the zone");
+    for (const Zone& zone : zones) {
+        out.line(PSTR("ac_option{zone=\"%s\",option=\"verticalSwing\"} %u\n"), zone.topic, zone.state.verticalSwing());
+        out.line(PSTR("ac_option{zone=\"%s\",option=\"horizontalSwing\"} %u\n"), zone.topic, zone.state.horizontalSwing());
+        out.line(PSTR("ac_option{zone=\"%s\",option=\"quietMode\"} %u\n"), zone.topic, zone.state.quiet);
+        out.line(PSTR("ac_option{zone=\"%s\",option=\"powerfulMode\"} %u\n"), zone.topic, zone.state.powerful);
+    }
+#if THERMOSTAT_ENABLED
+    METRIC_FAMILY(out, "ac_thermostat_demand", "gauge", "Controller demand of the zone, -1 when off, 0 idle, 1 run, 2 boost");
+    for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+        out.line(PSTR("ac_thermostat_demand{zone=\"%s\"} %d\n"), zones[i].topic, thermostats[i].enabled ? (int)thermostats[i].demand : -1);
+    }
+#endif
+
+    /* IR */
+    METRIC_FAMILY(out, "ac_ir_frames_total", "counter", "IR frames sent");
+    out.line(PSTR("ac_ir_frames_total %lu\n"), irTransmitter.frames);
+    METRIC_FAMILY(out, "ac_commands_coalesced_total", "counter", "Commands merged into a later frame");
+    for (const Zone& zone : zones) {
+        out.line(PSTR("ac_commands_coalesced_total{zone=\"%s\"} %lu\n"), zone.topic, zone.coalesced);
+    }
+    METRIC_FAMILY(out, "ac_frames_deduplicated_total", "counter", "Frames not sent as the AC had them already");
+    for (const Zone& zone : zones) {
+        out.line(PSTR("ac_frames_deduplicated_total{zone=\"%s\"} %lu\n"), zone.topic, zone.deduplicated);
+    }
+#if IR_RECV
+    METRIC_FAMILY(out, "ac_ir_received_total", "counter", "Frames of the AC remote decoded");
+    out.line(PSTR("ac_ir_received_total %lu\n"), irReceiver.frames);
+#endif
+
+    /* Latencies */
+#if STATS_ENABLED
+    // a summary, the histogram decays so its buckets are no counters
+    static const uint8_t quantiles[] = {50, 90, 99};
+    METRIC_FAMILY(out, "ac_latency_seconds", "summary", "Time spent in the instrumented paths, command is from the first command to its IR frame");
+    for (uint8_t i = 0; i < STAT_COUNT; i++) {
+        const LatencyStat& stat = stats.get((StatId)i);
+        const char* name = Stats::name(i);
+        for (uint8_t quantile : quantiles) {
+            out.line(PSTR("ac_latency_seconds{path=\"%s\",quantile=\"0.%u\"} %.6f\n"), name, quantile, stat.percentile(quantile) / 1e6);
+        }
+        out.line(PSTR("ac_latency_seconds_sum{path=\"%s\"} %.6f\n"), name, stat.total / 1e6);
+        out.line(PSTR("ac_latency_seconds_count{path=\"%s\"} %lu\n"), name, (unsigned long)stat.count);
+    }
+#endif
+
+    /* Device */
+    METRIC_FAMILY(out, "ac_heap_free_bytes", "gauge", "Free heap");
+    out.line(PSTR("ac_heap_free_bytes %lu\n"), (unsigned long)ESP.getFreeHeap());
+    METRIC_FAMILY(out, "ac_heap_max_block_bytes", "gauge", "Largest free heap block");
+    out.line(PSTR("ac_heap_max_block_bytes %lu\n"), (unsigned long)ESP.getMaxFreeBlockSize());
+    METRIC_FAMILY(out, "ac_heap_fragmentation_percent", "gauge", "Heap fragmentation");
+    out.line(PSTR("ac_heap_fragmentation_percent %u\n"), ESP.getHeapFragmentation());
+#if STATS_ENABLED
+    METRIC_FAMILY(out, "ac_heap_min_free_bytes", "gauge", "Lowest free heap sampled since boot");
+    out.line(PSTR("ac_heap_min_free_bytes %lu\n"), (unsigned long)stats.minFreeHeap);
+#endif
+    if (scheduler != nullptr) {
+        METRIC_FAMILY(out, "ac_heap_steady_allocations_total", "counter", "Heap allocations by tasks that must not allocate");
+        out.line(PSTR("ac_heap_steady_allocations_total %lu\n"), scheduler->steadyAllocations);
+    }
+    METRIC_FAMILY(out, "ac_wifi_rssi_dbm", "gauge", "Wi-Fi signal strength");
+    out.line(PSTR("ac_wifi_rssi_dbm %ld\n"), (long)WiFi.RSSI());
+    METRIC_FAMILY(out, "ac_wifi_drops_total", "counter", "Wi-Fi link losses");
+    out.line(PSTR("ac_wifi_drops_total %lu\n"), network.drops);
+    METRIC_FAMILY(out, "ac_uptime_seconds", "counter", "Time since boot");
+    out.line(PSTR("ac_uptime_seconds %lu\n"), millis() / 1000);
 }
+#endif
+
+// Serializes the latency figures and counters into `out`, the reply to a
+// {"stats":...} query
+size_t Ac::statsJson(char* out, size_t size, bool binary) {
+    static StaticJsonDocument<STATS_DOC_SIZE> doc;
+    doc.clear();
+
+    JsonObject root = doc.createNestedObject("stats");
+    stats.toJson(root);
+
+    unsigned long coalesced = 0;
+    unsigned long deduplicated = 0;
+    for (const Zone& zone : zones) {
+        coalesced += zone.coalesced;
+        deduplicated += zone.deduplicated;
+    }
+    root["coalesced"] = coalesced;
+    root["deduplicated"] = deduplicated;
+    root["logDropped"] = logger.dropped;
+    root["commits"] = store.commits;
+    root["erases"] = store.erases;
+    root["sensorFailures"] = sensor.failures;
+    root["sensorOverruns"] = sensor.overruns;
+    root["irFrames"] = irTransmitter.frames;
+#if GROUP_ENABLED
+    root["groupReceived"] = group.received;
+    root["groupRejected"] = group.rejected;
+    root["groupRepeated"] = group.repeated;
+#endif
+#if IR_RECV
+    root["irReceived"] = irReceiver.frames;
+    root["irUnknown"] = irReceiver.unknown;
+#endif
+#if IR_ASYNC
+    root["frameCacheHits"] = frames.hits;
+    root["frameCacheMisses"] = frames.misses;
+#endif
+    root["latencyTarget"] = POWER_LATENCY_MS;
+    root["latencyMisses"] = latencyMisses;
+    root["sleptMs"] = power.sleptMs;
+    root["uptime"] = millis();
+    root["clock"] = program.synced();
+    root["programRuns"] = program.runs;
+
+    JsonObject wifi = root.createNestedObject("wifi");
+    wifi["rssi"] = WiFi.RSSI();
+    wifi["bootMs"] = network.connectMs;
+    wifi["drops"] = network.drops;
+    wifi["reconnects"] = network.reconnects;
+    wifi["fromCache"] = network.cachedReconnects;
+    wifi["lastMs"] = network.lastReconnectMs;
+    wifi["maxMs"] = network.maxReconnectMs;
+
+#if THERMOSTAT_ENABLED
+    JsonObject controllers = root.createNestedObject("thermostats");
+    for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+        const Thermostat& thermostat = thermostats[i];
+        JsonObject entry = controllers.createNestedObject(zones[i].topic);
+        entry["enabled"] = thermostat.enabled;
+        entry["demand"] = demandName(thermostat.demand);
+        entry["cycles"] = thermostat.cycles;
+        // what the controller runs the unit at, targetMode stays the wanted one
+        entry["mode"] = modeName(zones[i].state.mode);
+        entry["fanSpeed"] = fanSpeedName(zones[i].state.fanSpeed);
+    }
+#endif
+
+    if (scheduler != nullptr) {
+        JsonObject tasks = root.createNestedObject("tasks");
+        for (uint8_t i = 0; i < scheduler->count; i++) {
+            const Task& task = scheduler->tasks[i];
+            JsonObject entry = tasks.createNestedObject(task.name);
+            entry["runs"] = task.runs;
+            entry["overruns"] = task.overruns;
+            entry["misses"] = task.misses;
+            entry["max"] = task.maxTime;
+            entry["allocs"] = task.allocations;
+        }
+        root["steadyAllocations"] = scheduler->steadyAllocations;
+    }
+
+    JsonArray list = root.createNestedArray("clients");
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        const Client& client = clients[num];
+        if (client.connected) {
+            JsonObject entry = list.createNestedObject();
+            entry["id"] = num;
+            entry["sent"] = client.sent;
+            entry["dropped"] = client.dropped;
+            entry["coalesced"] = client.coalesced;
+        }
+    }
 
-// Loads a setting value from EEPROM
-int Ac::load(int location) {
-    int value = EEPROM.read(location);
-    Serial.printf("Setting %d is equal to %d\n", location, value);
-    return value;
+    return binary ? serializeMsgPack(doc, out, size) : serializeJson(doc, out, size);
 }
 
-// Saves the settings to EEPROM
+// Stages the states, the store writes them to flash once things are quiet
 void Ac::save() {
-    if (dirty) {
-        Serial.println("Saving to EEPROM");
-        EEPROM.commit();
-        dirty = false;
+    for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+        saved.zones[i] = zones[i].state;
+#if THERMOSTAT_ENABLED
+        // what the clients want, the controller works it out again
+        if (thermostats[i].enabled) {
+            saved.zones[i].mode = thermostats[i].wantedMode;
+            saved.zones[i].fanSpeed = thermostats[i].wantedFanSpeed;
+        }
+#endif
+    }
+#if THERMOSTAT_ENABLED
+    saved.thermostats = 0;
+    for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+        saved.thermostats |= thermostats[i].enabled << i;
     }
+#endif
+    saved.temperatureOffset = temperatureFilter.offset;
+    saved.humidityOffset = humidityFilter.offset;
+    store.write(&saved);
 }
 
-// Restores Settings from EEPROM
+// Restores the states from flash, falling back to the settings the EEPROM
+// based firmware kept at fixed addresses. A record from before zones
+// existed only holds the first zone.
 void Ac::restore() {
-    verticalSwing = (load(S_VS) == 1) ? true : false;
-    horizontalSwing = (load(S_HS) == 1) ? true : false;
-    quietMode = (load(S_QM) == 1) ? true : false;
-    powerfulMode = (load(S_PM) == 1) ? true : false;
-
-    setTargetMode(targetMode);
-    setTargetFanSpeed(targetFanSpeed);
-    setVerticalSwing(verticalSwing);
-    setHorizontalSwing(horizontalSwing);
-    setQuietMode(quietMode);
-    setPowerfulMode(powerfulMode);
-}
\ No newline at end of file
+    for (uint8_t i = 0; i < ZONE_MAX; i++) {
+        saved.zones[i] = zones[i < ZONE_COUNT ? i : 0].state;
+    }
+    saved.temperatureOffset = temperatureFilter.offset;
+    saved.humidityOffset = humidityFilter.offset;
+    memset(&saved.wifi, 0, sizeof(saved.wifi));
+    saved.thermostats = 0;
+    saved.reserved = 0;
+    memset(saved.program, 0, sizeof(saved.program));
+    saved.reserved2 = 0;
+    saved.groupSequence = 0;
+
+    if (store.begin(&saved)) {
+        LOG_INFO("Restored state from flash");
+    } else {
+        uint8_t legacy[S_PM - S_VS + 1];
+        if (store.readLegacy(S_VS, legacy, sizeof(legacy))) {
+            saved.zones[0].setSwing(SWING_VERTICAL, legacy[S_VS - S_VS] == 1);
+            saved.zones[0].setSwing(SWING_HORIZONTAL, legacy[S_HS - S_VS] == 1);
+            saved.zones[0].quiet = legacy[S_QM - S_VS] == 1;
+            saved.zones[0].powerful = legacy[S_PM - S_VS] == 1;
+        }
+    }
+
+    for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+        zones[i].state = saved.zones[i];
+        zones[i].apply();
+#if THERMOSTAT_ENABLED
+        if (saved.thermostats & (1 << i)) {
+            thermostats[i].enable(zones[i].state);
+        }
+#endif
+    }
+
+    temperatureFilter.offset = saved.temperatureOffset;
+    humidityFilter.offset = saved.humidityOffset;
+#if GROUP_ENABLED
+    group.sequence = saved.groupSequence;
+#endif
+}
+
+const WifiCache& Ac::wifiCache() const {
+    return saved.wifi;
+}
+
+// Stages the AP for the next boot, written with the next record
+void Ac::rememberWifi(const WifiCache& cache) {
+    saved.wifi = cache;
+    save();
+}
@@ -0,0 +1,223 @@
+#include "backend.h"
+
+// Protocol values indexed by Mode / FanSpeed, MODE_OFF only powers off
+static const uint8_t daikinModes[] = {DAIKIN_COOL, DAIKIN_COOL, DAIKIN_HEAT, DAIKIN_FAN, DAIKIN_AUTO, DAIKIN_DRY};
+static const uint8_t daikinFanSpeeds[] = {DAIKIN_FAN_AUTO, DAIKIN_FAN_MIN, DAIKIN_FAN_MAX};
+
+static const uint8_t panasonicModes[] = {kPanasonicAcCool, kPanasonicAcCool, kPanasonicAcHeat, kPanasonicAcFan, kPanasonicAcAuto, kPanasonicAcDry};
+static const uint8_t panasonicFanSpeeds[] = {kPanasonicAcFanAuto, kPanasonicAcFanMin, kPanasonicAcFanMax};
+
+#define LOOKUP(table, value, fallback) ((value) < sizeof(table) ? table[value] : (fallback))
+
+// The Mode of a protocol mode, the other way round from LOOKUP
+static Mode modeOf(const uint8_t* table, uint8_t value) {
+    for (uint8_t i = MODE_COOL; i < kModeCount; i++) {
+        if (table[i] == value) {
+            return (Mode)i;
+        }
+    }
+    return MODE_AUTO;
+}
+
+// Remotes have steps between min and max, they go to the nearer end
+static FanSpeed fanSpeedOf(uint8_t value, uint8_t automatic, uint8_t min, uint8_t max) {
+    if (value == automatic || value < min || value > max) {
+        return FAN_AUTO;
+    }
+    return value - min < max - value ? FAN_MIN : FAN_MAX;
+}
+
+// Timings as IRremoteESP8266 sends them, for encoding frames ourselves
+#define DAIKIN_FREQ 38000
+#define DAIKIN_HDR_MARK 3650
+#define DAIKIN_HDR_SPACE 1623
+#define DAIKIN_BIT_MARK 428
+#define DAIKIN_ONE_SPACE 1280
+#define DAIKIN_ZERO_SPACE 428
+#define DAIKIN_GAP (DAIKIN_ZERO_SPACE + 29000)
+#define DAIKIN_LEADER_BITS 5
+#define DAIKIN_SECTION1_BYTES 8
+#define DAIKIN_SECTION2_BYTES 8
+
+#define PANASONIC_FREQ 36700
+#define PANASONIC_HDR_MARK 3456
+#define PANASONIC_HDR_SPACE 1728
+#define PANASONIC_BIT_MARK 432
+#define PANASONIC_ONE_SPACE 1296
+#define PANASONIC_ZERO_SPACE 432
+#define PANASONIC_SECTION_GAP 10000
+#define PANASONIC_MESSAGE_GAP 100000
+#define PANASONIC_SECTION1_BYTES 8
+
+/* Daikin */
+
+DaikinBackend::DaikinBackend(uint16_t pin) : ac(pin) {}
+
+void DaikinBackend::begin() {
+    ac.begin();
+}
+
+void DaikinBackend::setMode(Mode value) {
+    if (value == MODE_OFF) {
+        ac.off();
+        return;
+    }
+
+    ac.on();
+    ac.setMode(LOOKUP(daikinModes, value, DAIKIN_COOL));
+}
+
+void DaikinBackend::setFanSpeed(FanSpeed value) {
+    ac.setFan(LOOKUP(daikinFanSpeeds, value, DAIKIN_FAN_AUTO));
+}
+
+void DaikinBackend::setTemperature(uint8_t value) {
+    ac.setTemp(value);
+}
+
+void DaikinBackend::setVerticalSwing(bool value) {
+    ac.setSwingVertical(value);
+}
+
+void DaikinBackend::setHorizontalSwing(bool value) {
+    ac.setSwingHorizontal(value);
+}
+
+void DaikinBackend::setQuiet(bool value) {
+    ac.setQuiet(value);
+}
+
+void DaikinBackend::setPowerful(bool value) {
+    ac.setPowerful(value);
+}
+
+void DaikinBackend::send() {
+#if SEND_DAIKIN
+    ac.send();
+#endif  // SEND_DAIKIN
+}
+
+// A leader of five zero bits, then three sections
+void DaikinBackend::encode(IrFrame& frame) {
+    const uint8_t* data = ac.getRaw();
+    const uint8_t leader = 0;
+    const uint16_t section3 = kStateLength - DAIKIN_SECTION1_BYTES - DAIKIN_SECTION2_BYTES;
+
+    frame.begin(DAIKIN_FREQ, 0);
+    frame.section(0, 0, DAIKIN_BIT_MARK, DAIKIN_ONE_SPACE, DAIKIN_ZERO_SPACE, DAIKIN_GAP, &leader, DAIKIN_LEADER_BITS);
+    frame.section(DAIKIN_HDR_MARK, DAIKIN_HDR_SPACE, DAIKIN_BIT_MARK, DAIKIN_ONE_SPACE, DAIKIN_ZERO_SPACE, DAIKIN_GAP, data, DAIKIN_SECTION1_BYTES * 8);
+    data += DAIKIN_SECTION1_BYTES;
+    frame.section(DAIKIN_HDR_MARK, DAIKIN_HDR_SPACE, DAIKIN_BIT_MARK, DAIKIN_ONE_SPACE, DAIKIN_ZERO_SPACE, DAIKIN_GAP, data, DAIKIN_SECTION2_BYTES * 8);
+    data += DAIKIN_SECTION2_BYTES;
+    frame.section(DAIKIN_HDR_MARK, DAIKIN_HDR_SPACE, DAIKIN_BIT_MARK, DAIKIN_ONE_SPACE, DAIKIN_ZERO_SPACE, DAIKIN_GAP, data, section3 * 8);
+}
+
+uint8_t* DaikinBackend::raw() {
+    return ac.getRaw();
+}
+
+String DaikinBackend::toString() {
+    return ac.toString();
+}
+
+bool DaikinBackend::read(const decode_results& results, AcState& state) {
+    if (results.decode_type != decode_type_t::DAIKIN || results.bits != kStateLength * 8) {
+        return false;
+    }
+
+    ac.setRaw(results.state);
+    state.mode = ac.getPower() ? modeOf(daikinModes, ac.getMode()) : MODE_OFF;
+    state.fanSpeed = fanSpeedOf(ac.getFan(), DAIKIN_FAN_AUTO, DAIKIN_FAN_MIN, DAIKIN_FAN_MAX);
+    state.temperature = ac.getTemp();
+    state.swing = SWING_NONE;
+    state.setSwing(SWING_VERTICAL, ac.getSwingVertical());
+    state.setSwing(SWING_HORIZONTAL, ac.getSwingHorizontal());
+    state.quiet = ac.getQuiet();
+    state.powerful = ac.getPowerful();
+    return true;
+}
+
+/* Panasonic */
+
+PanasonicBackend::PanasonicBackend(uint16_t pin) : ac(pin) {}
+
+void PanasonicBackend::begin() {
+    ac.begin();
+    ac.setModel(kPanasonicRkr);
+}
+
+void PanasonicBackend::setMode(Mode value) {
+    if (value == MODE_OFF) {
+        ac.off();
+        return;
+    }
+
+    ac.on();
+    ac.setMode(LOOKUP(panasonicModes, value, kPanasonicAcCool));
+}
+
+void PanasonicBackend::setFanSpeed(FanSpeed value) {
+    ac.setFan(LOOKUP(panasonicFanSpeeds, value, kPanasonicAcFanAuto));
+}
+
+void PanasonicBackend::setTemperature(uint8_t value) {
+    ac.setTemp(value);
+}
+
+void PanasonicBackend::setVerticalSwing(bool value) {
+    ac.setSwingVertical(value ? kPanasonicAcSwingVAuto : kPanasonicAcSwingVHighest);
+}
+
+void PanasonicBackend::setHorizontalSwing(bool value) {
+    ac.setSwingHorizontal(value ? kPanasonicAcSwingHAuto : kPanasonicAcSwingHMiddle);
+}
+
+void PanasonicBackend::setQuiet(bool value) {
+    ac.setQuiet(value);
+}
+
+void PanasonicBackend::setPowerful(bool value) {
+    ac.setPowerful(value);
+}
+
+void PanasonicBackend::send() {
+#if SEND_PANASONIC_AC
+    ac.send();
+#endif  // SEND_PANASONIC_AC
+}
+
+// Two sections, the message gap is too long for a symbol and is left to the
+// transmitter
+void PanasonicBackend::encode(IrFrame& frame) {
+    const uint8_t* data = ac.getRaw();
+    const uint16_t section2 = kStateLength - PANASONIC_SECTION1_BYTES;
+
+    frame.begin(PANASONIC_FREQ, PANASONIC_MESSAGE_GAP);
+    frame.section(PANASONIC_HDR_MARK, PANASONIC_HDR_SPACE, PANASONIC_BIT_MARK, PANASONIC_ONE_SPACE, PANASONIC_ZERO_SPACE, PANASONIC_SECTION_GAP, data, PANASONIC_SECTION1_BYTES * 8);
+    frame.section(PANASONIC_HDR_MARK, PANASONIC_HDR_SPACE, PANASONIC_BIT_MARK, PANASONIC_ONE_SPACE, PANASONIC_ZERO_SPACE, 0, data + PANASONIC_SECTION1_BYTES, section2 * 8);
+}
+
+uint8_t* PanasonicBackend::raw() {
+    return ac.getRaw();
+}
+
+String PanasonicBackend::toString() {
+    return ac.toString();
+}
+
+bool PanasonicBackend::read(const decode_results& results, AcState& state) {
+    if (results.decode_type != decode_type_t::PANASONIC_AC || results.bits != kStateLength * 8) {
+        return false;
+    }
+
+    ac.setRaw(results.state);
+    state.mode = ac.getPower() ? modeOf(panasonicModes, ac.getMode()) : MODE_OFF;
+    state.fanSpeed = fanSpeedOf(ac.getFan(), kPanasonicAcFanAuto, kPanasonicAcFanMin, kPanasonicAcFanMax);
+    state.temperature = ac.getTemp();
+    state.swing = SWING_NONE;
+    state.setSwing(SWING_VERTICAL, ac.getSwingVertical() == kPanasonicAcSwingVAuto);
+    state.setSwing(SWING_HORIZONTAL, ac.getSwingHorizontal() == kPanasonicAcSwingHAuto);
+    state.quiet = ac.getQuiet();
+    state.powerful = ac.getPowerful();
+    return true;
+}
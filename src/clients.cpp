@@ -0,0 +1,116 @@
+#include "clients.h"
+
+static_assert((CLIENT_QUEUE_SIZE & (CLIENT_QUEUE_SIZE - 1)) == 0, "CLIENT_QUEUE_SIZE must be a power of two");
+
+#define MASK (CLIENT_QUEUE_SIZE - 1)
+
+static const char* const subscriptionNames[] = {"state", "sensor", "stats", "log"};
+
+uint8_t parseSubscription(const char* name) {
+    if (name == nullptr) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < sizeof(subscriptionNames) / sizeof(subscriptionNames[0]); i++) {
+        if (strcasecmp(name, subscriptionNames[i]) == 0) {
+            return 1 << i;
+        }
+    }
+    return 0;
+}
+
+Client::Client() {
+    reset(0);
+}
+
+void Client::reset(uint8_t zone) {
+    connected = false;
+    this->zone = zone;
+    subscriptions = SUB_DEFAULT;
+    binary = false;
+    fields = 0;
+    statsPending = false;
+    programPending = false;
+    historySeries = History::SERIES_COUNT;
+    historyCursor = 0;
+    sent = 0;
+    dropped = 0;
+    coalesced = 0;
+    head = 0;
+    tail = 0;
+}
+
+// Switches the format, queued messages are in the old one and dropped
+void Client::setBinary(bool value) {
+    if (value == binary) {
+        return;
+    }
+
+    binary = value;
+    while (head != tail) {
+        pop();
+        dropped++;
+    }
+}
+
+// Starts sending all of the history, from the oldest sample
+void Client::requestHistory() {
+    if (historySeries != History::SERIES_COUNT) {
+        coalesced++;
+    }
+    historySeries = History::SAMPLES;
+    historyCursor = 0;
+}
+
+// Marks state fields to send, merging them with any not sent yet
+void Client::update(uint16_t fields) {
+    if (!fields) {
+        return;
+    }
+
+    if (this->fields) {
+        coalesced++;
+    }
+    this->fields |= fields;
+}
+
+// Queues a message behind a two byte length, drops it when it does not fit
+bool Client::push(const char* data, size_t length) {
+    if (kQueueSize - (head - tail) < length + 2) {
+        dropped++;
+        return false;
+    }
+
+    queue[head++ & MASK] = length & 0xFF;
+    queue[head++ & MASK] = length >> 8;
+    for (size_t i = 0; i < length; i++) {
+        queue[head++ & MASK] = data[i];
+    }
+    return true;
+}
+
+// Copies the oldest queued message into `out`, returns 0 when there is none
+size_t Client::peek(char* out, size_t size) const {
+    if (head == tail) {
+        return 0;
+    }
+
+    size_t length = (uint8_t)queue[tail & MASK] | (size_t)(uint8_t)queue[(tail + 1) & MASK] << 8;
+    if (length > size) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        out[i] = queue[(tail + 2 + i) & MASK];
+    }
+    return length;
+}
+
+void Client::pop() {
+    if (head == tail) {
+        return;
+    }
+
+    size_t length = (uint8_t)queue[tail & MASK] | (size_t)(uint8_t)queue[(tail + 1) & MASK] << 8;
+    tail += 2 + length;
+}
@@ -0,0 +1,40 @@
+#include "filter.h"
+
+static_assert(FILTER_MEDIAN >= 1 && FILTER_MEDIAN <= 15, "FILTER_MEDIAN must be 1 to 15");
+static_assert(FILTER_EMA >= 1 && FILTER_EMA <= 256, "FILTER_EMA must be 1 to 256");
+
+Filter::Filter(int16_t offset) : offset(offset) {
+    count = 0;
+    next = 0;
+    average = 0;
+}
+
+// Adds a raw sample and returns the filtered value
+int16_t Filter::add(int16_t value) {
+    window[next] = value;
+    next = (next + 1) % kWindow;
+    if (count < kWindow) {
+        count++;
+    }
+
+    // median of what is there, insertion sort as the window is tiny
+    int16_t sorted[kWindow];
+    for (uint8_t i = 0; i < count; i++) {
+        int16_t v = window[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    int32_t median = sorted[count / 2];
+
+    if (count == 1) {
+        average = median << 8;
+    } else {
+        average += (((median << 8) - average) * FILTER_EMA) >> 8;
+    }
+
+    return ((average + 128) >> 8) + offset;
+}
@@ -0,0 +1,39 @@
+#include "framecache.h"
+
+FrameCache::FrameCache() {
+    hits = 0;
+    misses = 0;
+    clock = 0;
+    for (uint8_t i = 0; i < kSize; i++) {
+        entries[i].used = 0;
+    }
+}
+
+IrFrame* FrameCache::find(const AcState& state, uint32_t hash) {
+    for (uint8_t i = 0; i < kSize; i++) {
+        Entry& entry = entries[i];
+        if (entry.used && entry.hash == hash && entry.state == state) {
+            entry.used = ++clock;
+            hits++;
+            return &entry.frame;
+        }
+    }
+
+    misses++;
+    return nullptr;
+}
+
+// Returns the frame to encode `state` into, it must not be playing
+IrFrame* FrameCache::insert(const AcState& state, uint32_t hash) {
+    Entry* oldest = &entries[0];
+    for (uint8_t i = 1; i < kSize; i++) {
+        if (entries[i].used < oldest->used) {
+            oldest = &entries[i];
+        }
+    }
+
+    oldest->state = state;
+    oldest->hash = hash;
+    oldest->used = ++clock;
+    return &oldest->frame;
+}
@@ -0,0 +1,123 @@
+#include "group.h"
+
+#include "log.h"
+
+// IPAddress::toString() would allocate
+#define IP_FORMAT "%u.%u.%u.%u"
+#define IP_ARGS(ip) ip[0], ip[1], ip[2], ip[3]
+
+#if GROUP_ENABLED
+static_assert(sizeof(GROUP_KEY) > 16, "GROUP_KEY must be a secret of at least 16 characters");
+
+Group::Group() {
+    sequence = 0;
+    received = 0;
+    rejected = 0;
+    repeated = 0;
+    senderPort = 0;
+    address.fromString(GROUP_ADDRESS);
+    br_hmac_key_init(&key, &br_sha256_vtable, GROUP_KEY, sizeof(GROUP_KEY) - 1);
+}
+
+// Joins the group, again after every reconnect as the membership is per
+// link
+bool Group::begin() {
+    udp.stop();
+    if (!udp.beginMulticast(WiFi.localIP(), address, GROUP_PORT)) {
+        LOG_ERROR("Cannot join group %s:%u", GROUP_ADDRESS, GROUP_PORT);
+        return false;
+    }
+
+    LOG_INFO("Joined group %s:%u", GROUP_ADDRESS, GROUP_PORT);
+    return true;
+}
+
+// Returns the JSON body of the next new command, or nullptr. The body stays
+// valid until the next call and may be parsed in place.
+char* Group::read(size_t& length) {
+    int size = udp.parsePacket();
+    if (size <= 0) {
+        return nullptr;
+    }
+
+    received++;
+    sender = udp.remoteIP();
+    senderPort = udp.remotePort();
+
+    if ((size_t)size > sizeof(packet) || (size_t)size < sizeof(GroupHeader) + GROUP_MAC_SIZE) {
+        LOG_WARN("Group packet of %d bytes from " IP_FORMAT " dropped", size, IP_ARGS(sender));
+        udp.flush();
+        rejected++;
+        return nullptr;
+    }
+    udp.read(packet, size);
+
+    GroupHeader header;
+    memcpy(&header, packet, sizeof(header));
+    if (header.magic[0] != 'A' || header.magic[1] != 'G' || header.version != GROUP_VERSION || header.type != GROUP_COMMAND) {
+        rejected++;
+        return nullptr;
+    }
+
+    // compared in constant time, the timing would tell how much matched
+    uint8_t mac[GROUP_MAC_SIZE];
+    size_t signedLength = size - GROUP_MAC_SIZE;
+    sign(packet, signedLength, mac);
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < GROUP_MAC_SIZE; i++) {
+        diff |= mac[i] ^ packet[signedLength + i];
+    }
+    if (diff) {
+        LOG_WARN("Group packet from " IP_FORMAT " has a bad signature", IP_ARGS(sender));
+        rejected++;
+        return nullptr;
+    }
+
+    if (header.sequence < sequence) {
+        LOG_WARN("Group packet from " IP_FORMAT " has old sequence %lu", IP_ARGS(sender), (unsigned long)header.sequence);
+        rejected++;
+        return nullptr;
+    }
+
+    if (header.sequence == sequence) {
+        // the sender missed our ack
+        static const char body[] = "{\"ok\":true,\"repeated\":true}";
+        repeated++;
+        send(GROUP_ACK, body, sizeof(body) - 1);
+        return nullptr;
+    }
+
+    sequence = header.sequence;
+    length = signedLength - sizeof(GroupHeader);
+    return (char*)packet + sizeof(GroupHeader);
+}
+
+// Acknowledges the last command to its sender
+void Group::ack(const char* body, size_t length) {
+    send(GROUP_ACK, body, length);
+}
+
+void Group::sign(const uint8_t* data, size_t length, uint8_t* mac) {
+    br_hmac_context hmac;
+    br_hmac_init(&hmac, &key, 0);
+    br_hmac_update(&hmac, data, length);
+    br_hmac_out(&hmac, mac);
+}
+
+// Builds the packet in the receive buffer, the command in it is used up
+void Group::send(uint8_t type, const char* body, size_t length) {
+    if (sizeof(GroupHeader) + length + GROUP_MAC_SIZE > sizeof(packet)) {
+        return;
+    }
+
+    GroupHeader header = {{'A', 'G'}, GROUP_VERSION, type, sequence};
+    memcpy(packet, &header, sizeof(header));
+    memmove(packet + sizeof(header), body, length);
+    size_t signedLength = sizeof(header) + length;
+    sign(packet, signedLength, packet + signedLength);
+
+    udp.beginPacket(sender, senderPort);
+    udp.write(packet, signedLength + GROUP_MAC_SIZE);
+    udp.endPacket();
+}
+#endif  // GROUP_ENABLED
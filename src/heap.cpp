@@ -0,0 +1,35 @@
+#include "heap.h"
+
+// interrupt handlers may allocate too, so it is only counted masked
+static volatile uint32_t allocations = 0;
+
+uint32_t heapAllocations() {
+    return allocations;
+}
+
+static inline void count() {
+    uint32_t state = xt_rsil(15);
+    allocations++;
+    xt_wsr_ps(state);
+}
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    count();
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    count();
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    count();
+    return __real_realloc(ptr, size);
+}
+}
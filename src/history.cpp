@@ -0,0 +1,210 @@
+#include "history.h"
+
+#include <math.h>
+
+#define MINUTE 60
+#define HOUR 3600
+
+// a row never gets longer than this
+#define ROW_SIZE 96
+
+static const char* const seriesNames[] = {"samples", "minutes", "hours"};
+
+// Seconds since boot. millis() wraps after 49.7 days, which would send the
+// times and the paging cursors back to 0, micros64() does not.
+static uint32_t uptime() {
+    return micros64() / 1000000;
+}
+
+History::History() {
+    sampleCount = 0;
+    nextSample = 0;
+    minuteCount = 0;
+    nextMinute = 0;
+    hourCount = 0;
+    nextHour = 0;
+    open(minute, 0);
+    open(hour, 0);
+}
+
+void History::add(float temperature, float humidity) {
+    record(uptime(), lroundf(temperature * 10), lroundf(humidity * 10));
+}
+
+// Records a read that failed, so it shows as a gap rather than not at all
+void History::addMissing() {
+    record(uptime(), kMissing, 0);
+}
+
+void History::record(uint32_t time, int16_t temperature, uint16_t humidity) {
+    Sample& sample = samples[nextSample];
+    sample.time = time;
+    sample.temperature = temperature;
+    sample.humidity = humidity;
+    nextSample = (nextSample + 1) % HISTORY_SAMPLES;
+    if (sampleCount < HISTORY_SAMPLES) {
+        sampleCount++;
+    }
+
+    // close the minute and the hour once they are over
+    uint32_t start = time - time % MINUTE;
+    if (start != minute.start) {
+        if (minute.count) {
+            minutes[nextMinute] = minute;
+            nextMinute = (nextMinute + 1) % HISTORY_MINUTES;
+            if (minuteCount < HISTORY_MINUTES) {
+                minuteCount++;
+            }
+        }
+        open(minute, start);
+    }
+
+    start = time - time % HOUR;
+    if (start != hour.start) {
+        if (hour.count) {
+            hours[nextHour] = hour;
+            nextHour = (nextHour + 1) % HISTORY_HOURS;
+            if (hourCount < HISTORY_HOURS) {
+                hourCount++;
+            }
+        }
+        open(hour, start);
+    }
+
+    if (temperature != kMissing) {
+        fold(minute, temperature, humidity);
+        fold(hour, temperature, humidity);
+    }
+}
+
+void History::open(Aggregate& aggregate, uint32_t start) {
+    aggregate.start = start;
+    aggregate.count = 0;
+    aggregate.minTemperature = INT16_MAX;
+    aggregate.maxTemperature = INT16_MIN;
+    aggregate.minHumidity = UINT16_MAX;
+    aggregate.maxHumidity = 0;
+    aggregate.sumTemperature = 0;
+    aggregate.sumHumidity = 0;
+}
+
+void History::fold(Aggregate& aggregate, int16_t temperature, uint16_t humidity) {
+    aggregate.count++;
+    aggregate.sumTemperature += temperature;
+    aggregate.sumHumidity += humidity;
+    if (temperature < aggregate.minTemperature) {
+        aggregate.minTemperature = temperature;
+    }
+    if (temperature > aggregate.maxTemperature) {
+        aggregate.maxTemperature = temperature;
+    }
+    if (humidity < aggregate.minHumidity) {
+        aggregate.minHumidity = humidity;
+    }
+    if (humidity > aggregate.maxHumidity) {
+        aggregate.maxHumidity = humidity;
+    }
+}
+
+// Prints tenths as a decimal number
+static int printTenths(char* out, size_t size, int32_t value) {
+    uint32_t magnitude = value < 0 ? -value : value;
+    return snprintf(out, size, "%s%lu.%lu", value < 0 ? "-" : "", (unsigned long)(magnitude / 10), (unsigned long)(magnitude % 10));
+}
+
+static int printAggregate(char* out, size_t size, const History::Aggregate& aggregate) {
+    int32_t count = aggregate.count;
+    int length = snprintf(out, size, "[%lu,%u,", (unsigned long)aggregate.start, aggregate.count);
+    length += printTenths(out + length, size - length, aggregate.minTemperature);
+    out[length++] = ',';
+    length += printTenths(out + length, size - length, (aggregate.sumTemperature + count / 2) / count);
+    out[length++] = ',';
+    length += printTenths(out + length, size - length, aggregate.maxTemperature);
+    out[length++] = ',';
+    length += printTenths(out + length, size - length, aggregate.minHumidity);
+    out[length++] = ',';
+    length += printTenths(out + length, size - length, (aggregate.sumHumidity + count / 2) / count);
+    out[length++] = ',';
+    length += printTenths(out + length, size - length, aggregate.maxHumidity);
+    out[length++] = ']';
+    return length;
+}
+
+// Serializes the rows of `series` that start at or after `cursor`, as many
+// as fit into `out`. Moves `cursor` past the last row written, or to
+// UINT32_MAX once the series is complete. Returns 0 when not even one row
+// fits.
+//
+//   {"history":"samples","uptime":s,"data":[[time,temperature,humidity],...]}
+//   {"history":"minutes","uptime":s,"data":[[start,count,min,mean,max,
+//                                           minHumidity,meanHumidity,maxHumidity],...]}
+//
+// A failed read has null values, the current minute and hour come last.
+size_t History::toJson(Series series, uint32_t& cursor, char* out, size_t size) {
+    const char* closing = "]}";
+    int length = snprintf(out, size, "{\"history\":\"%s\",\"uptime\":%lu,\"data\":[", seriesNames[series], (unsigned long)uptime());
+    if (length < 0 || (size_t)length + 2 >= size) {
+        return 0;
+    }
+
+    uint16_t count = series == SAMPLES ? sampleCount : series == MINUTES ? minuteCount : hourCount;
+    const Aggregate& current = series == MINUTES ? minute : hour;
+    bool first = true;
+
+    // the stored rows oldest first, then the current aggregate
+    for (uint16_t i = 0; i <= count; i++) {
+        char row[ROW_SIZE];
+        int rowLength;
+        uint32_t time;
+
+        if (series == SAMPLES) {
+            if (i == count) {
+                break;
+            }
+            const Sample& sample = samples[(nextSample + HISTORY_SAMPLES - count + i) % HISTORY_SAMPLES];
+            time = sample.time;
+            if (time < cursor) {
+                continue;
+            }
+            if (sample.temperature == kMissing) {
+                rowLength = snprintf(row, sizeof(row), "[%lu,null,null]", (unsigned long)time);
+            } else {
+                rowLength = snprintf(row, sizeof(row), "[%lu,", (unsigned long)time);
+                rowLength += printTenths(row + rowLength, sizeof(row) - rowLength, sample.temperature);
+                row[rowLength++] = ',';
+                rowLength += printTenths(row + rowLength, sizeof(row) - rowLength, sample.humidity);
+                row[rowLength++] = ']';
+            }
+        } else {
+            const Aggregate* aggregate = &current;
+            if (i < count) {
+                aggregate = series == MINUTES ? &minutes[(nextMinute + HISTORY_MINUTES - count + i) % HISTORY_MINUTES] : &hours[(nextHour + HISTORY_HOURS - count + i) % HISTORY_HOURS];
+            }
+            time = aggregate->start;
+            if (time < cursor || !aggregate->count) {
+                continue;
+            }
+            rowLength = printAggregate(row, sizeof(row), *aggregate);
+        }
+
+        if ((size_t)(length + rowLength + 1 + 2) >= size) {
+            if (first) {
+                return 0;
+            }
+            memcpy(out + length, closing, 3);
+            return length + 2;
+        }
+
+        if (!first) {
+            out[length++] = ',';
+        }
+        memcpy(out + length, row, rowLength);
+        length += rowLength;
+        cursor = time + 1;
+        first = false;
+    }
+
+    memcpy(out + length, closing, 3);
+    cursor = UINT32_MAX;
+    return length + 2;
+}
@@ -0,0 +1,63 @@
+#include "irrx.h"
+
+#include "log.h"
+
+#if IR_RECV
+IrReceiver irReceiver;
+
+IrReceiver::IrReceiver() : irrecv(IR_RECV_PIN, IR_RECV_BUFFER, IR_RECV_TIMEOUT_MS, false) {
+    frames = 0;
+    unknown = 0;
+    overflows = 0;
+    paused = true;
+}
+
+void IrReceiver::begin() {
+    LOG_INFO("IR receiver on GPIO%u", IR_RECV_PIN);
+    resume();
+}
+
+// Stops capturing, a frame half captured is dropped
+void IrReceiver::pause() {
+    if (paused) {
+        return;
+    }
+
+    irrecv.disableIRIn();
+    paused = true;
+}
+
+void IrReceiver::resume() {
+    if (!paused) {
+        return;
+    }
+
+    irrecv.enableIRIn();
+    paused = false;
+}
+
+// Returns true with a decoded frame in `results`, the raw timings in it are
+// only valid until the next call
+bool IrReceiver::read(decode_results& results) {
+    if (paused || !irrecv.decode(&results)) {
+        return false;
+    }
+
+    // the decoded bytes are copied, so capturing can go on right away
+    irrecv.resume();
+
+    if (results.overflow) {
+        LOG_ERROR("IR capture does not fit IR_RECV_BUFFER");
+        overflows++;
+        return false;
+    }
+
+    if (results.decode_type == decode_type_t::UNKNOWN) {
+        unknown++;
+        return false;
+    }
+
+    frames++;
+    return true;
+}
+#endif  // IR_RECV
@@ -0,0 +1,180 @@
+#include "irtx.h"
+
+#include "log.h"
+
+IrTransmitter irTransmitter;
+
+/* IrFrame */
+
+void IrFrame::begin(uint32_t frequency, uint32_t gap) {
+    this->frequency = frequency;
+    this->gap = gap;
+    symbolCount = 0;
+    overflow = false;
+    length = 0;
+}
+
+// Appends a mark or space, whichever is next
+void IrFrame::add(uint16_t us) {
+    uint8_t symbol = 0;
+    while (symbol < symbolCount && durations[symbol] != us) {
+        symbol++;
+    }
+
+    if (symbol == symbolCount) {
+        if (symbolCount >= IR_MAX_SYMBOLS) {
+            overflow = true;
+            return;
+        }
+        durations[symbolCount++] = us;
+    }
+
+    if (length >= IR_FRAME_SIZE) {
+        overflow = true;
+        return;
+    }
+    symbols[length++] = symbol;
+}
+
+// Appends a section the way IRsend::sendGeneric sends it, least significant
+// bit first. A zero footer space ends the frame with the footer mark.
+void IrFrame::section(uint16_t headerMark, uint16_t headerSpace, uint16_t bitMark, uint16_t oneSpace, uint16_t zeroSpace, uint16_t footerSpace, const uint8_t* data, uint16_t bits) {
+    if (headerMark) {
+        add(headerMark);
+        add(headerSpace);
+    }
+
+    for (uint16_t i = 0; i < bits; i++) {
+        add(bitMark);
+        add((data[i / 8] >> (i % 8)) & 1 ? oneSpace : zeroSpace);
+    }
+
+    add(bitMark);
+    if (footerSpace) {
+        add(footerSpace);
+    }
+}
+
+/* IrTransmitter */
+
+// timer1 runs from the 80 MHz APB clock with TIM_DIV1
+#define TICKS_PER_S 80000000UL
+
+// The timer reloads itself every carrier half period and the whole frame is
+// counted in those, marks and spaces alike. Re-arming it from the interrupt
+// instead would add the interrupt latency to every half period.
+static struct {
+    const IrFrame* frame;
+    uint32_t mask;
+    uint32_t halfPeriod;              // carrier half period in ticks
+    uint16_t halves[IR_MAX_SYMBOLS];  // carrier half periods per symbol
+    uint16_t index;
+    uint16_t remaining;
+    bool high;
+    volatile bool active;
+    volatile bool done;
+    volatile uint32_t endedAt;
+} tx;
+
+static void IRAM_ATTR startSegment() {
+    tx.remaining = tx.halves[tx.frame->symbols[tx.index]];
+
+    if (!(tx.index & 1)) {
+        GPOS = tx.mask;
+        tx.high = true;
+    }
+}
+
+static void IRAM_ATTR onTimer() {
+    if (--tx.remaining) {
+        if (tx.index & 1) {
+            return;
+        }
+        if (tx.high) {
+            GPOC = tx.mask;
+        } else {
+            GPOS = tx.mask;
+        }
+        tx.high = !tx.high;
+        return;
+    }
+
+    GPOC = tx.mask;
+    tx.high = false;
+
+    if (++tx.index >= tx.frame->length) {
+        timer1_disable();
+        tx.endedAt = micros();
+        tx.active = false;
+        tx.done = true;
+        return;
+    }
+
+    startSegment();
+}
+
+IrTransmitter::IrTransmitter() {
+    frames = 0;
+}
+
+void IrTransmitter::begin() {
+    timer1_isr_init();
+    timer1_attachInterrupt(onTimer);
+}
+
+// Starts playing `frame` on `pin`, which has to stay untouched until
+// finished(). Returns false while the previous frame or its gap is running.
+bool IrTransmitter::start(const IrFrame& frame, uint8_t pin) {
+    if (busy() || frame.length == 0) {
+        return false;
+    }
+
+    if (frame.overflow) {
+        LOG_ERROR("IR frame does not fit IR_FRAME_SIZE");
+        return false;
+    }
+
+    if (pin > 15) {
+        LOG_ERROR("IR pin %u cannot be driven from the timer", pin);
+        return false;
+    }
+
+    // precompute everything so the interrupt only looks values up
+    for (uint8_t i = 0; i < frame.symbolCount; i++) {
+        uint32_t halves = ((uint64_t)frame.durations[i] * frame.frequency * 2 + 500000) / 1000000;
+        tx.halves[i] = halves > 1 ? halves : 1;
+    }
+
+    pinMode(pin, OUTPUT);
+    tx.frame = &frame;
+    tx.mask = 1UL << pin;
+    tx.halfPeriod = (TICKS_PER_S + frame.frequency) / (2 * frame.frequency);
+    tx.index = 0;
+    tx.done = false;
+    tx.active = true;
+    frames++;
+
+    startSegment();
+    timer1_enable(TIM_DIV1, TIM_EDGE, TIM_LOOP);
+    timer1_write(tx.halfPeriod);
+    return true;
+}
+
+// True while a frame plays or the quiet time after it has not passed yet
+bool IrTransmitter::busy() {
+    if (tx.active) {
+        return true;
+    }
+
+    return tx.frame != nullptr && micros() - tx.endedAt < tx.frame->gap;
+}
+
+// Returns true once after every frame
+bool IrTransmitter::finished() {
+    if (!tx.done) {
+        return false;
+    }
+
+    tx.done = false;
+    return true;
+}
@@ -0,0 +1,172 @@
+#include "log.h"
+
+#include <ESP8266WiFi.h>
+#include <stdarg.h>
+
+Logger logger;
+
+static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0, "LOG_BUFFER_SIZE must be a power of two");
+
+#define MASK (LOG_BUFFER_SIZE - 1)
+
+// the first character of every line in the buffer is its level
+static const char levelTags[] = {'-', 'E', 'W', 'I', 'D'};
+
+Logger::Logger() {
+    dropped = 0;
+    head = 0;
+    uartTail = 0;
+    lineTail = 0;
+    sinkCount = 0;
+    hostname = "thermostat";
+
+#if LOG_SYSLOG
+    addSink(syslog, nullptr);
+#endif
+}
+
+void Logger::log(uint8_t level, const char* format, ...) {
+    char line[kLineSize];
+    line[0] = levelTags[level < sizeof(levelTags) ? level : 0];
+    line[1] = ' ';
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf_P(line + 2, sizeof(line) - 3, format, args);
+    va_end(args);
+
+    if (length < 0) {
+        return;
+    }
+
+    size_t total = 2 + ((size_t)length < sizeof(line) - 3 ? length : sizeof(line) - 4);
+    line[total++] = '\n';
+
+    // room is bounded by whichever reader is further behind
+    uint32_t pending = head - uartTail;
+    if (sinkCount && head - lineTail > pending) {
+        pending = head - lineTail;
+    }
+    if (kBufferSize - pending < total) {
+        dropped++;
+        return;
+    }
+
+    append(line, total);
+}
+
+void Logger::addSink(LogSink sink, void* context) {
+    if (sinkCount >= kMaxSinks) {
+        return;
+    }
+
+    sinks[sinkCount] = sink;
+    contexts[sinkCount] = context;
+    sinkCount++;
+}
+
+void Logger::setHostname(const char* name) {
+    hostname = name;
+}
+
+// Moves buffered output on without ever waiting for the UART
+void Logger::drain() {
+#if LOG_UART
+    drainUart(Serial.availableForWrite());
+#else
+    uartTail = head;
+#endif
+
+    // at most one line per pass, a sink may be slow
+    if (sinkCount) {
+        drainLine();
+    } else {
+        lineTail = head;
+    }
+}
+
+// Writes out everything, waiting for the UART. Only for boot and reset.
+void Logger::flush() {
+#if LOG_UART
+    drainUart(head - uartTail);
+    Serial.flush();
+#else
+    uartTail = head;
+#endif
+
+    while (sinkCount && drainLine()) {
+    }
+}
+
+void Logger::append(const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        buffer[(head + i) & MASK] = data[i];
+    }
+    head += length;
+}
+
+void Logger::drainUart(size_t room) {
+    while (room && uartTail != head) {
+        size_t start = uartTail & MASK;
+        size_t length = head - uartTail;
+        if (length > kBufferSize - start) {
+            length = kBufferSize - start;
+        }
+        if (length > room) {
+            length = room;
+        }
+
+        Serial.write((const uint8_t*)buffer + start, length);
+        uartTail += length;
+        room -= length;
+    }
+}
+
+// Hands the next complete line to the sinks, returns false if there is none
+bool Logger::drainLine() {
+    char line[kLineSize];
+    size_t length = 0;
+
+    for (uint32_t i = lineTail; i != head; i++) {
+        char c = buffer[i & MASK];
+        if (c == '\n') {
+            uint8_t level = 0;
+            for (uint8_t j = 0; j < sizeof(levelTags); j++) {
+                if (levelTags[j] == line[0]) {
+                    level = j;
+                }
+            }
+
+            lineTail = i + 1;
+            line[length] = '\0';
+            for (uint8_t j = 0; j < sinkCount; j++) {
+                sinks[j](contexts[j], level, line + 2, length - 2);
+            }
+            return true;
+        }
+
+        if (length < sizeof(line) - 1) {
+            line[length++] = c;
+        }
+    }
+
+    return false;
+}
+
+// RFC 3164 style, facility local0
+void Logger::syslog(void* context, uint8_t level, const char* line, size_t length) {
+    static WiFiUDP udp;
+    static const uint8_t severities[] = {7, 3, 4, 6, 7};
+
+    if (!WiFi.isConnected()) {
+        return;
+    }
+
+    char header[48];
+    int size = snprintf(header, sizeof(header), "<%u>%s: ", 16 * 8 + severities[level], logger.hostname);
+
+    udp.beginPacket(LOG_SYSLOG_HOST, LOG_SYSLOG_PORT);
+    udp.write((const uint8_t*)header, size);
+    udp.write((const uint8_t*)line, length);
+    udp.endPacket();
+}
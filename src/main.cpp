@@ -6,92 +6,181 @@
 #include <WiFiManager.h>  // https://github.com/tzapu/WiFiManager WiFi Configuration Magic
 
 #include "ac.h"
+#include "irtx.h"
+#include "log.h"
+#include "metrics.h"
+#include "network.h"
+#include "power.h"
+#include "scheduler.h"
 #include "settings.h"
+#include "stats.h"
 
 Ac ac;
+Scheduler scheduler;
 
 // parameters
 char device_name[40];
 char hostname[18];
 bool resetRequired = false;
-unsigned long loopLastRun;
 
 void saveConfigCallback() {
-    Serial.println("Resetting device...");
+    LOG_INFO("Resetting device...");
+    logger.flush();
     delay(5000);
     resetRequired = true;
 }
 
+// Logs how long boot took up to `phase`, and since the previous one
+void bootPhase(const char* phase) {
+    static unsigned long previous = 0;
+    unsigned long now = millis();
+    LOG_INFO("Boot: %s at %lu ms (+%lu)", phase, now, now - previous);
+    previous = now;
+}
+
+// Announces the WebSocket server, run once clients can already connect
+void startMdns() {
+    if (MDNS.begin(hostname, WiFi.localIP())) {
+        LOG_INFO("MDNS responder started");
+    }
+
+    MDNS.addService("oznu-platform", "tcp", 81);
+    MDNS.addServiceTxt("oznu-platform", "tcp", "type", "daikin-thermostat");
+    MDNS.addServiceTxt("oznu-platform", "tcp", "mac", WiFi.macAddress());
+#if GROUP_ENABLED
+    MDNS.addServiceTxt("oznu-platform", "tcp", "group", GROUP_ADDRESS);
+    MDNS.addServiceTxt("oznu-platform", "tcp", "groupPort", String(GROUP_PORT));
+#endif
+    bootPhase("mdns");
+}
+
 void setup(void) {
     pinMode(LED_BUILTIN, OUTPUT);
 
     // turn LED on at boot
     digitalWrite(LED_BUILTIN, LOW);
 
-    Serial.begin(9600, SERIAL_8N1, SERIAL_TX_ONLY);
+    Serial.begin(SERIAL_BAUD, SERIAL_8N1, SERIAL_TX_ONLY);
     WiFi.mode(WIFI_STA);
 
-    delay(1000);
+    LOG_INFO("Starting...");
 
-    Serial.println("Starting...");
+    // setup hostname, from the last three bytes of the MAC
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    snprintf(hostname, sizeof(hostname), "thermostat-%02x%02x%02x", mac[3], mac[4], mac[5]);
 
-    // WiFiManager, Local intialization. Once its business is done, there is no need to keep it around
-    WiFiManager wm;
+    WiFi.hostname(hostname);
+    LOG_INFO("%s", hostname);
+    logger.setHostname(hostname);
 
-    // setup hostname
-    String id = WiFi.macAddress();
-    id.replace(":", "");
-    id.toLowerCase();
-    id = id.substring(6, 12);
-    id = "thermostat-" + id;
-    id.toCharArray(hostname, 18);
+    // the state is back and IR works before there is any network
+    ac.begin();
+    bootPhase("restore");
 
-    WiFi.hostname(hostname);
-    Serial.println(hostname);
+    bool connected = false;
+#if FAST_BOOT
+    network.cache = ac.wifiCache();
+    connected = network.connect(WIFI_CONNECT_TIMEOUT_MS);
+#endif
 
-    // reset the device after config is saved
-    wm.setSaveConfigCallback(saveConfigCallback);
+    if (!connected) {
+        logger.flush();
 
-    // sets timeout until configuration portal gets turned off
-    wm.setTimeout(600);
+        // WiFiManager, Local intialization. Once its business is done, there is no need to keep it around
+        WiFiManager wm;
 
-    // first parameter is name of access point, second is the password
-    if (!wm.autoConnect(hostname, "password")) {
-        Serial.println("Failed to connect and hit timeout");
-        delay(3000);
+        // reset the device after config is saved
+        wm.setSaveConfigCallback(saveConfigCallback);
 
-        // reset and try again
-        ESP.reset();
-        delay(5000);
-    }
+        // sets timeout until configuration portal gets turned off
+        wm.setTimeout(WIFI_PORTAL_TIMEOUT_S);
 
-    WiFi.hostname(hostname);
+        // first parameter is name of access point, second is the password
+        if (!wm.autoConnect(hostname, "password")) {
+            LOG_ERROR("Failed to connect and hit timeout");
+            logger.flush();
+            delay(3000);
+
+            // reset and try again
+            ESP.reset();
+            delay(5000);
+        }
+
+        WiFi.hostname(hostname);
+    }
 
     // reset if flagged
     if (resetRequired) {
         ESP.reset();
     }
+    bootPhase("wifi");
 
-    // Add service to MDNS-sd
-    delay(2000);
+    // serve commands right away, mDNS follows from the loop
+    ac.serve();
+#if METRICS_ENABLED
+    metrics.begin(ac);
+#endif
+    bootPhase("websocket");
 
-    if (MDNS.begin(hostname, WiFi.localIP())) {
-        Serial.println("MDNS responder started");
+    if (network.remember()) {
+        ac.rememberWifi(network.cache);
     }
-
-    MDNS.addService("oznu-platform", "tcp", 81);
-    MDNS.addServiceTxt("oznu-platform", "tcp", "type", "daikin-thermostat");
-    MDNS.addServiceTxt("oznu-platform", "tcp", "mac", WiFi.macAddress());
-    // MDNS end
+    network.begin();
+    power.begin();
 
     // ac start
-    ac.begin();
+    ac.schedule(scheduler);
+    scheduler.add("log", [](void*) { logger.drain(); }, nullptr, POLL_MS, TASK_BUDGET_IO_US);
+    // mDNS allocates per query, the link per reconnect
+    Task* mdns = scheduler.add("mdns", [](void*) {
+        static bool started = false;
+        if (!started) {
+            started = true;
+            startMdns();
+        }
+        MDNS.update();
+    }, nullptr, POLL_MS, TASK_BUDGET_IO_US, Scheduler::IO);
+    scheduler.allowHeap(mdns);
+    Task* wifi = scheduler.add("wifi", [](void*) {
+        if (network.loop()) {
+            // maybe a new IP, and clients missed whatever happened meanwhile
+            MDNS.notifyAPChange();
+#if GROUP_ENABLED
+            ac.group.begin();
+#endif
+            ac.resync();
+            if (network.remember()) {
+                ac.rememberWifi(network.cache);
+            }
+        }
+    }, nullptr, WIFI_SUPERVISE_MS, TASK_BUDGET_IO_US);
+    scheduler.allowHeap(wifi);
+#if METRICS_ENABLED
+    // the web server parses requests into Strings
+    scheduler.allowHeap(scheduler.add("http", [](void*) { metrics.loop(); }, nullptr, POLL_MS, TASK_BUDGET_BROADCAST_US, Scheduler::IO));
+#endif
+#if STATS_ENABLED
+    scheduler.add("heap", [](void*) { stats.sampleHeap(); }, nullptr, STATS_HEAP_MS, TASK_BUDGET_BROADCAST_US);
+#endif
+#if SCHEDULER_REPORT_MS
+    scheduler.add("report", [](void*) { scheduler.report(); }, nullptr, SCHEDULER_REPORT_MS, TASK_BUDGET_BROADCAST_US);
+#endif
 
     // turn LED off once ready
     digitalWrite(LED_BUILTIN, HIGH);
+    bootPhase("ready");
 }
 
 void loop(void) {
-    ac.loop();
-    MDNS.update();
+    {
+        STATS_TIME(STAT_LOOP);
+        scheduler.run();
+    }
+
+    // sleep until the next task is due, the timer stops in light sleep so
+    // not while an IR frame plays
+    if (!irTransmitter.busy()) {
+        power.idle(scheduler.idleTime());
+    }
 }
@@ -0,0 +1,99 @@
+#include "metrics.h"
+
+#if METRICS_ENABLED
+#include "ac.h"
+#include "log.h"
+
+Metrics metrics;
+
+/* MetricsWriter */
+
+MetricsWriter::MetricsWriter(ESP8266WebServer& server) : server(server) {
+    sent = 0;
+    dropped = 0;
+    length = 0;
+}
+
+// Appends formatted text, the format is in flash. A line that does not fit
+// any more goes into the next chunk, one longer than a whole chunk is
+// dropped, cut it would run into the next line.
+void MetricsWriter::line(const char* format, ...) {
+    va_list args;
+
+    for (uint8_t attempt = 0; attempt < 2; attempt++) {
+        va_start(args, format);
+        int written = vsnprintf_P(buffer + length, sizeof(buffer) - length, format, args);
+        va_end(args);
+
+        if (written < 0) {
+            return;
+        }
+        if (length + written < sizeof(buffer)) {
+            length += written;
+            return;
+        }
+        if (length == 0) {
+            LOG_WARN("Metrics line longer than METRICS_CHUNK_SIZE dropped");
+            dropped++;
+            return;
+        }
+        flush();
+    }
+}
+
+void MetricsWriter::flush() {
+    if (length == 0) {
+        return;
+    }
+
+    server.sendContent(buffer, length);
+    sent += length;
+    length = 0;
+}
+
+/* Metrics */
+
+Metrics::Metrics() : server(METRICS_PORT) {
+    scrapes = 0;
+    dropped = 0;
+    lastMs = 0;
+    ac = nullptr;
+}
+
+void Metrics::begin(Ac& ac) {
+    this->ac = &ac;
+
+    server.on("/metrics", HTTP_GET, [this]() { handle(); });
+    server.onNotFound([this]() { server.send(404, "text/plain", "Not found\n"); });
+    server.begin();
+    LOG_INFO("Metrics on port %u", METRICS_PORT);
+}
+
+void Metrics::loop() {
+    server.handleClient();
+}
+
+void Metrics::handle() {
+    unsigned long started = millis();
+
+    // chunked, the length is not known up front
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/plain; version=0.0.4", "");
+
+    MetricsWriter out(server);
+    ac->writeMetrics(out);
+    dropped += out.dropped;
+    METRIC_FAMILY(out, "ac_metrics_dropped_lines_total", "counter", "Lines longer than a chunk left out");
+    out.line(PSTR("ac_metrics_dropped_lines_total %lu\n"), dropped);
+    METRIC_FAMILY(out, "ac_metrics_scrapes_total", "counter", "Scrapes served");
+    out.line(PSTR("ac_metrics_scrapes_total %lu\n"), ++scrapes);
+    METRIC_FAMILY(out, "ac_metrics_scrape_seconds", "gauge", "Time the previous scrape took");
+    out.line(PSTR("ac_metrics_scrape_seconds %.3f\n"), lastMs / 1000.0);
+    out.flush();
+
+    // ends the chunked body
+    server.sendContent("", 0);
+
+    lastMs = millis() - started;
+}
+#endif  // METRICS_ENABLED
@@ -0,0 +1,159 @@
+#include "network.h"
+
+#include <ESP8266WiFi.h>
+
+#include "log.h"
+
+Network network;
+
+Network::Network() {
+    memset(&cache, 0, sizeof(cache));
+    state = OFFLINE;
+    cached = false;
+    connectMs = 0;
+    drops = 0;
+    reconnects = 0;
+    cachedReconnects = 0;
+    lastReconnectMs = 0;
+    maxReconnectMs = 0;
+    lostAt = 0;
+    attemptAt = 0;
+}
+
+// Connects with the stored credentials, returns false if there are none or
+// no AP answered within `timeoutMs`
+bool Network::connect(uint32_t timeoutMs) {
+    if (WiFi.SSID().length() == 0) {
+        LOG_INFO("No stored Wi-Fi credentials");
+        return false;
+    }
+
+    unsigned long started = millis();
+    bool connected = false;
+
+    if (cache.channel) {
+        attempt(true);
+        connected = wait(started, WIFI_CACHED_TIMEOUT_MS);
+        if (!connected) {
+            LOG_WARN("AP not found on channel %u, scanning", cache.channel);
+        }
+    }
+
+    if (!connected) {
+        attempt(false);
+        connected = wait(started, timeoutMs);
+    }
+
+    connectMs = millis() - started;
+    if (connected) {
+        LOG_INFO("Connected in %lu ms%s", connectMs, cached ? " from cache" : "");
+    }
+    return connected;
+}
+
+// Copies the current BSSID and channel into the cache, returns true if
+// they changed
+bool Network::remember() {
+    WifiCache current;
+    memset(&current, 0, sizeof(current));
+    memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+    current.channel = WiFi.channel();
+
+    if (memcmp(&current, &cache, sizeof(cache)) == 0) {
+        return false;
+    }
+    cache = current;
+    return true;
+}
+
+// Takes over reconnecting from the SDK, call once connected
+void Network::begin() {
+    WiFi.setAutoReconnect(false);
+    state = WiFi.status() == WL_CONNECTED ? ONLINE : SCANNING;
+    attemptAt = millis();
+    lostAt = attemptAt;
+}
+
+// Watches the link and reconnects, returns true once after every reconnect
+bool Network::loop() {
+    bool up = WiFi.status() == WL_CONNECTED;
+    unsigned long now = millis();
+
+    switch (state) {
+        case OFFLINE:
+            return false;
+        case ONLINE:
+            if (!up) {
+                drops++;
+                lostAt = now;
+                LOG_WARN("Wi-Fi link lost");
+                attempt(cache.channel != 0);
+            }
+            return false;
+        case CACHED:
+            if (up) {
+                return online();
+            }
+            if (now - attemptAt > WIFI_CACHED_TIMEOUT_MS) {
+                attempt(false);
+            }
+            return false;
+        case SCANNING:
+            if (up) {
+                return online();
+            }
+            // the AP may be back on its old channel by now
+            if (now - attemptAt > WIFI_CONNECT_TIMEOUT_MS) {
+                attempt(cache.channel != 0);
+            }
+            return false;
+    }
+    return false;
+}
+
+// Starts associating, with the cached AP or with a scan. The credentials
+// are stored already, passing them again must not rewrite the flash.
+void Network::attempt(bool fromCache) {
+    String ssid = WiFi.SSID();
+    String psk = WiFi.psk();
+
+    WiFi.persistent(false);
+    if (fromCache) {
+        WiFi.begin(ssid.c_str(), psk.c_str(), cache.channel, cache.bssid);
+    } else {
+        WiFi.disconnect();
+        WiFi.begin(ssid.c_str(), psk.c_str());
+    }
+    WiFi.persistent(true);
+
+    cached = fromCache;
+    state = fromCache ? CACHED : SCANNING;
+    attemptAt = millis();
+}
+
+bool Network::online() {
+    uint32_t took = millis() - lostAt;
+    lastReconnectMs = took;
+    if (took > maxReconnectMs) {
+        maxReconnectMs = took;
+    }
+    reconnects++;
+    if (cached) {
+        cachedReconnects++;
+    }
+
+    state = ONLINE;
+    LOG_INFO("Wi-Fi back after %u ms%s", took, cached ? " from cache" : "");
+    return true;
+}
+
+// Polls the station status until connected or `timeoutMs` after `started`
+bool Network::wait(unsigned long started, uint32_t timeoutMs) {
+    while (millis() - started < timeoutMs) {
+        if (WiFi.status() == WL_CONNECTED) {
+            return true;
+        }
+        delay(10);
+    }
+    return WiFi.status() == WL_CONNECTED;
+}
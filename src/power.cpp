@@ -0,0 +1,49 @@
+#include "power.h"
+
+#include <ESP8266WiFi.h>
+
+#include "log.h"
+
+Power power;
+
+Power::Power() {
+    sleeps = 0;
+    sleptMs = 0;
+
+    // what is left of the latency target once the loop had its turn
+    long budget = (long)POWER_LATENCY_MS - SEND_MAX_DELAY_MS - POWER_POLL_MS;
+    long beacons = budget / BEACON_MS;
+    listenInterval = beacons < 1 ? 1 : beacons > 10 ? 10 : beacons;
+}
+
+// Sets the sleep type, call once connected
+void Power::begin() {
+#if POWER_SAVE == POWER_LIGHT_SLEEP
+    WiFi.setSleepMode(WIFI_LIGHT_SLEEP, listenInterval);
+#elif POWER_SAVE == POWER_MODEM_SLEEP
+    WiFi.setSleepMode(WIFI_MODEM_SLEEP, listenInterval);
+#endif
+
+#if POWER_SAVE
+    LOG_INFO("Wi-Fi sleep %d, listen interval %u", POWER_SAVE, listenInterval);
+    if ((long)POWER_LATENCY_MS < SEND_MAX_DELAY_MS + POWER_POLL_MS + BEACON_MS) {
+        LOG_WARN("POWER_LATENCY_MS cannot be met, listening to every beacon");
+    }
+#endif
+}
+
+// Sleeps for `ms`, the radio and core sleep on their own meanwhile
+void Power::idle(uint32_t ms) {
+#if POWER_SAVE
+    if (ms == 0) {
+        return;
+    }
+    if (ms > POWER_POLL_MS) {
+        ms = POWER_POLL_MS;
+    }
+
+    sleeps++;
+    sleptMs += ms;
+    delay(ms);
+#endif
+}
@@ -0,0 +1,94 @@
+#include "program.h"
+
+#include <time.h>
+
+#include "log.h"
+
+// Anything before this is a clock NTP has not set yet
+#define PROGRAM_EPOCH 1700000000
+
+Program::Program() {
+    runs = 0;
+    last = UINT16_MAX;
+}
+
+// Starts NTP, the clock is set some time later
+void Program::begin() {
+    configTime(PROGRAM_TIMEZONE, PROGRAM_NTP_SERVER);
+}
+
+bool Program::synced() const {
+    return time(nullptr) > PROGRAM_EPOCH;
+}
+
+// Returns true with the next minute of the week the clock passed, once for
+// every minute
+bool Program::tick(uint16_t& weekMinute) {
+    time_t now = time(nullptr);
+    if (now < PROGRAM_EPOCH) {
+        return false;
+    }
+
+    struct tm local;
+    localtime_r(&now, &local);
+    uint16_t current = local.tm_wday * MINUTES_PER_DAY + local.tm_hour * 60 + local.tm_min;
+
+    uint16_t behind = (current + MINUTES_PER_WEEK - (last == UINT16_MAX ? current : last)) % MINUTES_PER_WEEK;
+    if (last == UINT16_MAX || behind > PROGRAM_CATCH_UP_MIN) {
+        // start with the current minute, everything before it is over
+        last = (current + MINUTES_PER_WEEK - 1) % MINUTES_PER_WEEK;
+    } else if (behind == 0) {
+        return false;
+    }
+
+    last = (last + 1) % MINUTES_PER_WEEK;
+    weekMinute = last;
+    return true;
+}
+
+bool Program::matches(const ProgramEntry& entry, uint16_t weekMinute) {
+    uint8_t day = weekMinute / MINUTES_PER_DAY;
+    return (entry.days & (1 << day)) && entry.minute == weekMinute % MINUTES_PER_DAY;
+}
+
+// Reads {"days":62,"at":"07:00","mode":"heat","temperature":21} into
+// `entry`, mode and temperature are optional
+bool Program::parse(JsonVariant value, uint8_t zone, ProgramEntry& entry) {
+    unsigned hour, minute;
+    const char* at = value["at"];
+    if (at == nullptr || sscanf(at, "%u:%u", &hour, &minute) != 2 || hour > 23 || minute > 59) {
+        return false;
+    }
+
+    uint8_t days = value["days"] | 0x7F;
+    if ((days & 0x7F) == 0) {
+        return false;
+    }
+
+    Mode mode;
+    const char* name = value["mode"];
+    if (name != nullptr && !parseMode(name, &mode)) {
+        return false;
+    }
+
+    entry.days = days & 0x7F;
+    entry.zone = zone;
+    entry.minute = hour * 60 + minute;
+    entry.mode = name != nullptr ? mode : PROGRAM_KEEP;
+    entry.temperature = value["temperature"] | 0;
+    return true;
+}
+
+void Program::toJson(const ProgramEntry& entry, JsonObject out) {
+    char at[6];
+    snprintf(at, sizeof(at), "%02u:%02u", entry.minute / 60, entry.minute % 60);
+
+    out["days"] = entry.days;
+    out["at"] = at;
+    if (entry.mode != PROGRAM_KEEP) {
+        out["mode"] = modeName((Mode)entry.mode);
+    }
+    if (entry.temperature) {
+        out["temperature"] = entry.temperature;
+    }
+}
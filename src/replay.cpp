@@ -0,0 +1,155 @@
+#include "replay.h"
+
+static_assert((REPLAY_PENDING & (REPLAY_PENDING - 1)) == 0 && REPLAY_PENDING <= 128, "REPLAY_PENDING must be a power of two up to 128");
+
+// Captured from the Homebridge plugin: a characteristic per message, dragged
+// sliders send every step and the Home app repeats the mode on power up
+static const char* const trace[] = {
+    "{\"targetMode\":\"cool\"}",
+    "{\"targetTemperature\":24}",
+    "{\"targetTemperature\":23}",
+    "{\"targetTemperature\":22}",
+    "{\"targetFanSpeed\":\"max\"}",
+    "{\"verticalSwing\":true}",
+    "{\"targetFanSpeed\":\"auto\"}",
+    "{\"targetTemperature\":21}",
+    "{\"quietMode\":true}",
+    "{\"targetMode\":\"off\"}",
+    "{\"targetMode\":\"heat\",\"targetTemperature\":25}",
+    "{\"targetMode\":\"heat\"}",
+    "{\"powerfulMode\":true}",
+    "{\"horizontalSwing\":true}",
+    "{\"targetFanSpeed\":\"min\",\"quietMode\":false}",
+    "{\"targetMode\":\"off\",\"force\":true}",
+};
+
+static const uint16_t kTraceLength = sizeof(trace) / sizeof(trace[0]);
+
+// How long the last commands may take to be acknowledged
+#define REPLAY_DRAIN_MS 2000
+
+Replay::Replay() {
+    active = false;
+    ir = false;
+    reportPending = false;
+    client = 0;
+    zone = 0;
+    rate = REPLAY_RATE;
+    count = 0;
+    issued = 0;
+    acked = 0;
+    unmeasured = 0;
+    minFreeHeap = 0;
+    startedAt = 0;
+    lastAt = 0;
+    position = 0;
+    head = 0;
+    tail = 0;
+}
+
+void Replay::start(uint8_t num, uint8_t zone, uint16_t rate, uint32_t count, bool ir) {
+    this->client = num;
+    this->zone = zone;
+    this->rate = constrain(rate, 1, REPLAY_MAX_RATE);
+    this->count = count ? count : kTraceLength;
+    this->ir = ir;
+
+    active = true;
+    reportPending = false;
+    issued = 0;
+    acked = 0;
+    unmeasured = 0;
+    minFreeHeap = ESP.getFreeHeap();
+    latency.reset();
+    position = 0;
+    head = 0;
+    tail = 0;
+    startedAt = millis();
+    lastAt = startedAt;
+}
+
+// Ends the replay and queues the results, commands still in flight stay
+// unmeasured
+void Replay::stop() {
+    if (!active) {
+        return;
+    }
+
+    active = false;
+    reportPending = true;
+    unmeasured += (uint8_t)(head - tail);
+    head = 0;
+    tail = 0;
+}
+
+// Copies the next command of the trace into `out` and starts its timing,
+// returns 0 once `count` commands went in
+size_t Replay::next(char* out, size_t size) {
+    if (!active || issued >= count) {
+        return 0;
+    }
+
+    const char* command = trace[position];
+    position = (position + 1) % kTraceLength;
+
+    size_t length = strlen(command);
+    if (length >= size) {
+        return 0;
+    }
+    memcpy(out, command, length + 1);
+
+    if ((uint8_t)(head - tail) < REPLAY_PENDING) {
+        pending[head++ % REPLAY_PENDING] = micros();
+    } else {
+        unmeasured++;
+    }
+    issued++;
+    lastAt = millis();
+
+    uint32_t heap = ESP.getFreeHeap();
+    if (heap < minFreeHeap) {
+        minFreeHeap = heap;
+    }
+    return length;
+}
+
+// The state went out to the client, which ends every open timing
+void Replay::acknowledged() {
+    uint32_t now = micros();
+    while (tail != head) {
+        latency.add(now - pending[tail++ % REPLAY_PENDING]);
+        acked++;
+    }
+}
+
+// True once all commands went in and were acknowledged, or gave up on
+bool Replay::finished() const {
+    return active && issued >= count && (head == tail || millis() - lastAt > REPLAY_DRAIN_MS);
+}
+
+// ms between two commands, once a second while idle
+uint32_t Replay::period() const {
+    return active ? 1000 / rate : 1000;
+}
+
+// The sustained rate is measured over the time it took to issue the
+// commands, a device that cannot keep up issues them late
+void Replay::toJson(JsonObject out) {
+    unsigned long elapsed = lastAt - startedAt;
+
+    out["active"] = active;
+    out["ir"] = ir;
+    out["rate"] = rate;
+    out["commands"] = issued;
+    out["acked"] = acked;
+    out["unmeasured"] = unmeasured;
+    out["ms"] = elapsed;
+    out["perSecond"] = elapsed && issued > 1 ? (issued - 1) * 1000.0f / elapsed : 0.0f;
+    out["minFreeHeap"] = minFreeHeap;
+
+    JsonObject timing = out.createNestedObject("latency");
+    timing["p50"] = latency.percentile(50);
+    timing["p90"] = latency.percentile(90);
+    timing["p99"] = latency.percentile(99);
+    timing["max"] = latency.max;
+}
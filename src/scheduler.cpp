@@ -0,0 +1,156 @@
+#include "scheduler.h"
+
+#include "heap.h"
+#include "log.h"
+
+Scheduler::Scheduler() {
+    count = 0;
+    steadyAllocations = 0;
+    steady = false;
+}
+
+// Adds a task that first runs on the next pass, returns nullptr when full
+Task* Scheduler::add(const char* name, TaskCallback callback, void* context, uint32_t period, uint32_t budget, Priority priority) {
+    if (count >= kMaxTasks) {
+        LOG_ERROR("No room for task %s", name);
+        return nullptr;
+    }
+
+    Task& task = tasks[count++];
+    memset(&task, 0, sizeof(Task));
+    task.name = name;
+    task.callback = callback;
+    task.context = context;
+    task.period = period;
+    task.budget = budget;
+    task.priority = priority;
+    task.due = millis();
+    return &task;
+}
+
+// Changes the period, the next run moves accordingly
+void Scheduler::setPeriod(Task* task, uint32_t period) {
+    if (task == nullptr || task->period == period) {
+        return;
+    }
+
+    task->due = task->due - task->period + period;
+    task->period = period;
+}
+
+// Makes a task due on the next pass
+void Scheduler::wake(Task* task) {
+    if (task != nullptr) {
+        task->due = millis();
+    }
+}
+
+// Exempts a task from the steady state check, e.g. one that polls a library
+// which allocates per request
+void Scheduler::allowHeap(Task* task) {
+    if (task != nullptr) {
+        task->allocates = true;
+    }
+}
+
+// Counts `allocations` made by `name` once steady, it must not make any
+void Scheduler::checkHeap(const char* name, uint32_t allocations) {
+    if (!allocations || !steady) {
+        return;
+    }
+
+    if (!steadyAllocations) {
+        LOG_ERROR("%s allocated on the heap", name);
+    }
+    steadyAllocations += allocations;
+#if HEAP_STRICT
+    panic();
+#endif
+}
+
+void Scheduler::run() {
+    unsigned long now = millis();
+    Task* next = nullptr;
+    long nextLate = -1;
+
+    if (now >= HEAP_STEADY_MS) {
+        steady = true;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        Task& task = tasks[i];
+        long late = (long)(now - task.due);
+        if (late < 0) {
+            continue;
+        }
+
+        if (task.priority == IO) {
+            execute(task, now);
+        } else if (late > nextLate) {
+            next = &task;
+            nextLate = late;
+        }
+    }
+
+    if (next != nullptr) {
+        execute(*next, now);
+    }
+}
+
+// Milliseconds until the next task is due
+uint32_t Scheduler::idleTime() {
+    unsigned long now = millis();
+    uint32_t idle = UINT32_MAX;
+
+    for (uint8_t i = 0; i < count; i++) {
+        long left = (long)(tasks[i].due - now);
+        if (left <= 0) {
+            return 0;
+        }
+        if ((uint32_t)left < idle) {
+            idle = left;
+        }
+    }
+
+    return idle;
+}
+
+// Logs one line per task
+void Scheduler::report() {
+    for (uint8_t i = 0; i < count; i++) {
+        Task& task = tasks[i];
+        LOG_INFO("%-10s runs %lu overruns %lu misses %lu max %uus allocs %lu", task.name, task.runs, task.overruns, task.misses, task.maxTime, task.allocations);
+    }
+}
+
+void Scheduler::execute(Task& task, unsigned long now) {
+    if (task.period && now - task.due > task.period) {
+        task.misses++;
+    }
+
+    uint32_t allocations = heapAllocations();
+    uint32_t started = micros();
+    task.callback(task.context);
+    uint32_t elapsed = micros() - started;
+    allocations = heapAllocations() - allocations;
+
+    task.allocations += allocations;
+    if (!task.allocates) {
+        checkHeap(task.name, allocations);
+    }
+
+    task.runs++;
+    if (elapsed > task.maxTime) {
+        task.maxTime = elapsed;
+    }
+    if (elapsed > task.budget) {
+        task.overruns++;
+    }
+
+    // keep the cadence unless the task fell a whole period behind
+    if (task.period && now - task.due < task.period) {
+        task.due += task.period;
+    } else {
+        task.due = now + task.period;
+    }
+}
@@ -0,0 +1,210 @@
+#include "sensor.h"
+
+#include <limits.h>
+
+#include "log.h"
+
+// The DHT22 wakes up after 1 ms low, the DHT11 needs at least 18 ms
+#define START_LOW_US(type) ((type) == 11 ? 20000UL : 1100UL)
+
+// 80us response + 40 bits of at most 120us each, with some slack
+#define CAPTURE_US 6000UL
+
+// high pulses longer than this are a 1 bit (~27us for 0, ~70us for 1)
+#define ONE_THRESHOLD_US 48
+
+Sensor::Sensor(uint8_t pin, uint8_t type) : pin(pin), type(type) {
+    phase = IDLE;
+    overruns = 0;
+    failures = 0;
+    retries = 0;
+    interval = SENSOR_INTERVAL_MS;
+    fresh = false;
+    lost = false;
+    hasSample = false;
+    lastTemperature = 0;
+    lastHumidity = 0;
+    sampledAt = 0;
+    dueAt = 0;
+    count = 0;
+    rise = 0;
+}
+
+void Sensor::begin() {
+    pinMode(pin, INPUT_PULLUP);
+
+    // the sensor needs a moment after power up before it answers
+    schedule(SENSOR_RETRY_MS);
+}
+
+// Advances the read by at most one phase. A new read is never started while
+// `busy` is set, so commands and IR sends are not delayed by the sensor.
+void Sensor::loop(bool busy) {
+    unsigned long started = micros();
+
+    switch (phase) {
+        case IDLE:
+            if (busy || (long)(millis() - dueAt) < 0) {
+                return;
+            }
+            pinMode(pin, OUTPUT);
+            digitalWrite(pin, LOW);
+            phaseStart = micros();
+            phase = START;
+            break;
+        case START:
+            if (micros() - phaseStart < START_LOW_US(type)) {
+                return;
+            }
+            count = 0;
+            rise = 0;
+            pinMode(pin, INPUT_PULLUP);
+            attachInterruptArg(digitalPinToInterrupt(pin), onEdge, this, CHANGE);
+            phaseStart = micros();
+            phase = CAPTURE;
+            break;
+        case CAPTURE:
+            if (micros() - phaseStart < CAPTURE_US) {
+                return;
+            }
+            detachInterrupt(digitalPinToInterrupt(pin));
+            finish();
+            break;
+    }
+
+    if (micros() - started > SENSOR_BUDGET_US) {
+        overruns++;
+    }
+}
+
+// Schedules a read as soon as the sensor allows
+void Sensor::request() {
+    if (phase == IDLE) {
+        dueAt = millis();
+    }
+}
+
+// Changes the time between samples, a sample already due later moves in too
+void Sensor::setInterval(unsigned long ms) {
+    if (ms == interval) {
+        return;
+    }
+
+    interval = ms;
+    if (phase == IDLE && retries == 0 && hasSample) {
+        dueAt = sampledAt + interval;
+    }
+}
+
+// Returns true once for every new good sample
+bool Sensor::available() {
+    bool res = fresh;
+    fresh = false;
+    return res;
+}
+
+// Returns true once for every sample that failed including its retries
+bool Sensor::missed() {
+    bool res = lost;
+    lost = false;
+    return res;
+}
+
+bool Sensor::valid() const {
+    return hasSample;
+}
+
+float Sensor::temperature() const {
+    return lastTemperature;
+}
+
+float Sensor::humidity() const {
+    return lastHumidity;
+}
+
+// Milliseconds since the last good sample
+unsigned long Sensor::age() const {
+    return hasSample ? millis() - sampledAt : ULONG_MAX;
+}
+
+// Records the width of every high pulse, which encodes one bit each
+void IRAM_ATTR Sensor::onEdge(void* arg) {
+    Sensor* self = static_cast<Sensor*>(arg);
+    uint32_t now = micros();
+
+    if (digitalRead(self->pin) == HIGH) {
+        self->rise = now;
+    } else if (self->rise && self->count < kMaxPulses) {
+        uint32_t width = now - self->rise;
+        self->pulses[self->count++] = width > 255 ? 255 : width;
+    }
+}
+
+void Sensor::finish() {
+    phase = IDLE;
+
+    if (decode()) {
+        retries = 0;
+        schedule(interval);
+        return;
+    }
+
+    failures++;
+    LOG_WARN("Failed to read from DHT sensor!");
+
+    if (++retries <= SENSOR_RETRIES) {
+        schedule(SENSOR_RETRY_MS);
+    } else {
+        retries = 0;
+        lost = true;
+        schedule(interval);
+    }
+}
+
+// Decodes the last 40 high pulses: the first one or two are the sensor's
+// response and the line release, which are not data.
+bool Sensor::decode() {
+    if (count < 40) {
+        return false;
+    }
+
+    uint8_t data[5] = {0, 0, 0, 0, 0};
+    uint8_t first = count - 40;
+    for (uint8_t i = 0; i < 40; i++) {
+        data[i / 8] <<= 1;
+        if (pulses[first + i] > ONE_THRESHOLD_US) {
+            data[i / 8] |= 1;
+        }
+    }
+
+    if (((data[0] + data[1] + data[2] + data[3]) & 0xFF) != data[4]) {
+        return false;
+    }
+
+    float humidity;
+    float temp;
+    if (type == 11) {
+        humidity = data[0] + data[1] * 0.1;
+        temp = data[2] + (data[3] & 0x7F) * 0.1;
+        if (data[3] & 0x80) {
+            temp = -temp;
+        }
+    } else {
+        humidity = ((data[0] << 8) | data[1]) * 0.1;
+        temp = (((data[2] & 0x7F) << 8) | data[3]) * 0.1;
+        if (data[2] & 0x80) {
+            temp = -temp;
+        }
+    }
+
+    lastTemperature = temp;
+    lastHumidity = humidity;
+    sampledAt = millis();
+    hasSample = true;
+    fresh = true;
+    return true;
+}
+
+void Sensor::schedule(unsigned long delayMs) {
+    dueAt = millis() + delayMs;
+}
@@ -0,0 +1,37 @@
+#include "state.h"
+
+#define COUNT(names) (sizeof(names) / sizeof(names[0]))
+
+static int find(const char* const names[], uint8_t count, const char* name) {
+    if (name == nullptr) {
+        return -1;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (strcasecmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool parseMode(const char* name, Mode* value) {
+    int i = find(kModeNames, COUNT(kModeNames), name);
+    if (i < 0) {
+        return false;
+    }
+
+    *value = (Mode)i;
+    return true;
+}
+
+bool parseFanSpeed(const char* name, FanSpeed* value) {
+    int i = find(kFanSpeedNames, COUNT(kFanSpeedNames), name);
+    if (i < 0) {
+        return false;
+    }
+
+    *value = (FanSpeed)i;
+    return true;
+}
@@ -0,0 +1,149 @@
+#include "stats.h"
+
+Stats stats;
+
+static const char* const statNames[STAT_COUNT] = {
+    "webSocketEvent",
+    "parse",
+    "setTargetMode",
+    "setTargetFanSpeed",
+    "setTemperature",
+    "setVerticalSwing",
+    "setHorizontalSwing",
+    "setQuietMode",
+    "setPowerfulMode",
+    "irSend",
+    "toJson",
+    "broadcast",
+    "sensor",
+    "commit",
+    "loop",
+    "command",
+};
+
+const char* Stats::name(uint8_t id) {
+    return id < STAT_COUNT ? statNames[id] : "";
+}
+
+LatencyStat::LatencyStat() {
+    reset();
+}
+
+void LatencyStat::add(uint32_t us) {
+    count++;
+    total += us;
+    if (us < min) {
+        min = us;
+    }
+    if (us > max) {
+        max = us;
+    }
+
+    uint8_t i = bucket(us);
+    if (buckets[i] == UINT16_MAX) {
+        samples = 0;
+        for (uint8_t j = 0; j < kBuckets; j++) {
+            buckets[j] /= 2;
+            samples += buckets[j];
+        }
+    }
+    buckets[i]++;
+    samples++;
+}
+
+void LatencyStat::reset() {
+    count = 0;
+    min = UINT32_MAX;
+    max = 0;
+    total = 0;
+    samples = 0;
+    memset(buckets, 0, sizeof(buckets));
+}
+
+uint32_t LatencyStat::average() const {
+    return count ? total / count : 0;
+}
+
+// Upper bound of the bucket holding the given percentile
+uint32_t LatencyStat::percentile(uint8_t pct) const {
+    if (samples == 0) {
+        return 0;
+    }
+
+    uint32_t target = ((uint64_t)samples * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < kBuckets; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            uint32_t bound = upperBound(i);
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+// 0 and 1 get their own buckets, then two per power of two
+uint8_t LatencyStat::bucket(uint32_t us) {
+    if (us < 2) {
+        return us;
+    }
+
+    uint8_t octave = 31 - __builtin_clz(us);
+    uint8_t i = 2 * octave + ((us >> (octave - 1)) & 1);
+    return i < kBuckets ? i : kBuckets - 1;
+}
+
+uint32_t LatencyStat::upperBound(uint8_t bucket) {
+    if (bucket < 2) {
+        return bucket;
+    }
+
+    uint8_t octave = bucket / 2;
+    uint32_t lower = (uint32_t)(2 + bucket % 2) << (octave - 1);
+    return lower + (1UL << (octave - 1)) - 1;
+}
+
+Stats::Stats() {
+    freeHeap = 0;
+    minFreeHeap = UINT32_MAX;
+    maxFreeBlock = 0;
+    fragmentation = 0;
+    maxFragmentation = 0;
+}
+
+LatencyStat& Stats::get(StatId id) {
+    return latencies[id];
+}
+
+// Walks the heap, so only call it every now and then
+void Stats::sampleHeap() {
+    freeHeap = ESP.getFreeHeap();
+    maxFreeBlock = ESP.getMaxFreeBlockSize();
+    fragmentation = ESP.getHeapFragmentation();
+
+    if (freeHeap < minFreeHeap) {
+        minFreeHeap = freeHeap;
+    }
+    if (fragmentation > maxFragmentation) {
+        maxFragmentation = fragmentation;
+    }
+}
+
+void Stats::toJson(JsonObject out) {
+    for (uint8_t i = 0; i < STAT_COUNT; i++) {
+        const LatencyStat& stat = latencies[i];
+        JsonObject entry = out.createNestedObject(statNames[i]);
+        entry["n"] = stat.count;
+        entry["min"] = stat.count ? stat.min : 0;
+        entry["avg"] = stat.average();
+        entry["p99"] = stat.percentile(99);
+        entry["max"] = stat.max;
+    }
+
+    JsonObject heap = out.createNestedObject("heap");
+    heap["free"] = freeHeap;
+    heap["minFree"] = minFreeHeap;
+    heap["maxBlock"] = maxFreeBlock;
+    heap["fragmentation"] = fragmentation;
+    heap["maxFragmentation"] = maxFragmentation;
+}
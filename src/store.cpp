@@ -0,0 +1,168 @@
+#include "store.h"
+
+#include "stats.h"
+
+#define STORE_MAGIC 0xAC5E
+
+// the sector the linker script reserves for EEPROM
+extern "C" uint32_t _EEPROM_start;
+
+Store::Store(uint8_t version, size_t length) : version(version), length(length) {
+    commits = 0;
+    erases = 0;
+    address = 0;
+    sequence = 0;
+    next = 0;
+    dirty = false;
+    lastFlush = 0;
+    memset(slot, 0, sizeof(slot));
+}
+
+// Loads the newest valid record into `data`, returns false if there is none
+// and leaves `data` untouched
+bool Store::begin(void* data) {
+    address = (uintptr_t)&_EEPROM_start - 0x40200000;
+
+    uint32_t buffer[kSlotSize / 4];
+    int newest = -1;
+
+    for (uint16_t i = 0; i < kSlots; i++) {
+        if (!readSlot(i, buffer)) {
+            continue;
+        }
+
+        Header* header = (Header*)buffer;
+        if (newest < 0 || (int32_t)(header->sequence - sequence) > 0) {
+            newest = i;
+            sequence = header->sequence;
+            memcpy(slot, buffer, kSlotSize);
+        }
+    }
+
+    // continue after the newest record, in the next slot that is still erased
+    next = newest + 1;
+    while (next < kSlots && !erased(next)) {
+        next++;
+    }
+
+    if (newest < 0) {
+        return false;
+    }
+
+    // records written by an older build may be shorter
+    Header* header = (Header*)slot;
+    uint8_t* payload = (uint8_t*)slot + sizeof(Header);
+    memcpy(data, payload, header->length < length ? header->length : length);
+    memcpy(payload, data, length);
+    return true;
+}
+
+// Reads bytes from the sector as EEPROM left them, before the first record
+bool Store::readLegacy(uint32_t offset, uint8_t* data, size_t size) {
+    uint32_t start = offset & ~3;
+    uint32_t words[4];
+    if (offset + size - start > sizeof(words)) {
+        return false;
+    }
+
+    if (!ESP.flashRead(address + start, words, sizeof(words))) {
+        return false;
+    }
+
+    memcpy(data, (uint8_t*)words + (offset - start), size);
+    return true;
+}
+
+// Stages a new copy of the record, it is written by a later flush
+void Store::write(const void* data) {
+    uint8_t* payload = (uint8_t*)slot + sizeof(Header);
+    if (memcmp(payload, data, length) == 0) {
+        return;
+    }
+
+    memcpy(payload, data, length);
+    dirty = true;
+}
+
+// Flushes the staged record once the interval passed and nothing else is going on
+void Store::loop(bool busy) {
+    if (dirty && !busy && millis() - lastFlush >= STORE_INTERVAL_MS) {
+        flush();
+    }
+}
+
+void Store::flush() {
+    if (!dirty) {
+        return;
+    }
+
+    STATS_TIME(STAT_COMMIT);
+
+    if (next >= kSlots) {
+        ESP.flashEraseSector(address / kSectorSize);
+        erases++;
+        next = 0;
+    }
+
+    Header* header = (Header*)slot;
+    header->magic = STORE_MAGIC;
+    header->version = version;
+    header->length = length;
+    header->sequence = ++sequence;
+    header->crc = 0;
+    header->crc = crc32((uint8_t*)slot, kSlotSize);
+
+    ESP.flashWrite(address + next * kSlotSize, slot, kSlotSize);
+    next++;
+    commits++;
+
+    dirty = false;
+    lastFlush = millis();
+}
+
+bool Store::pending() const {
+    return dirty;
+}
+
+uint32_t Store::crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// Reads a slot into `out`, returns true if it holds a valid record
+bool Store::readSlot(uint16_t index, uint32_t* out) {
+    if (!ESP.flashRead(address + index * kSlotSize, out, kSlotSize)) {
+        return false;
+    }
+
+    Header* header = (Header*)out;
+    if (header->magic != STORE_MAGIC || header->version != version || header->length > kMaxLength) {
+        return false;
+    }
+
+    uint32_t crc = header->crc;
+    header->crc = 0;
+    bool valid = crc32((uint8_t*)out, kSlotSize) == crc;
+    header->crc = crc;
+    return valid;
+}
+
+bool Store::erased(uint16_t index) {
+    uint32_t buffer[kSlotSize / 4];
+    if (!ESP.flashRead(address + index * kSlotSize, buffer, kSlotSize)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < kSlotSize / 4; i++) {
+        if (buffer[i] != 0xFFFFFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
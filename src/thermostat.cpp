@@ -0,0 +1,105 @@
+#include "thermostat.h"
+
+#include <math.h>
+
+Thermostat::Thermostat() {
+    enabled = false;
+    demand = RUN;
+    wantedMode = MODE_OFF;
+    wantedFanSpeed = FAN_AUTO;
+    cycles = 0;
+    direction = MODE_COOL;
+    changedAt = 0;
+}
+
+// Takes over the zone, `state` is what the clients want right now
+void Thermostat::enable(const AcState& state) {
+    enabled = true;
+    demand = RUN;
+    wantedMode = state.mode;
+    wantedFanSpeed = state.fanSpeed;
+    direction = state.mode == MODE_HEAT ? MODE_HEAT : MODE_COOL;
+
+    // a unit that just started may stop right away, it was not started by us
+    changedAt = millis() - THERMOSTAT_MIN_ON_MS;
+}
+
+void Thermostat::disable() {
+    enabled = false;
+    demand = RUN;
+}
+
+// Works out the mode and fan speed for the zone, `state` holds its target
+// temperature. Returns false while disabled.
+bool Thermostat::decide(const AcState& state, float temperature, unsigned long now, Mode& mode, FanSpeed& fanSpeed) {
+    if (!enabled) {
+        return false;
+    }
+
+    mode = wantedMode;
+    fanSpeed = wantedFanSpeed;
+    unsigned long held = now - changedAt;
+
+    if (!controls(wantedMode) || isnan(temperature)) {
+        // passed through, but a compressor that just stopped stays off for
+        // its minimum all the same. Off and fan only do not start it.
+        if (demand == IDLE && !compresses(wantedMode)) {
+            demand = RUN;
+        } else if (demand == IDLE && held >= THERMOSTAT_MIN_OFF_MS) {
+            demand = RUN;
+            changedAt = now;
+            cycles++;
+        }
+    } else {
+        if (demand == IDLE && wantedMode == MODE_AUTO) {
+            direction = temperature > state.temperature ? MODE_COOL : MODE_HEAT;
+        } else if (wantedMode != MODE_AUTO) {
+            direction = wantedMode;
+        }
+
+        // positive while the room still has to cool or heat
+        float error = direction == MODE_COOL ? temperature - state.temperature : state.temperature - temperature;
+
+        if (demand == IDLE) {
+            if (error > THERMOSTAT_HYSTERESIS && held >= THERMOSTAT_MIN_OFF_MS) {
+                demand = RUN;
+                changedAt = now;
+                cycles++;
+            }
+        } else if (error < -THERMOSTAT_HYSTERESIS && held >= THERMOSTAT_MIN_ON_MS) {
+            demand = IDLE;
+            changedAt = now;
+        }
+
+        // the fan steps down at half the boost, so it does not flap
+        if (demand == RUN && error > THERMOSTAT_BOOST) {
+            demand = BOOST;
+        } else if (demand == BOOST && error < THERMOSTAT_BOOST / 2) {
+            demand = RUN;
+        }
+
+        if (demand != IDLE) {
+            mode = direction;
+            if (demand == BOOST && wantedFanSpeed == FAN_AUTO) {
+                fanSpeed = FAN_MAX;
+            }
+        }
+    }
+
+    if (demand == IDLE) {
+        mode = MODE_FAN;
+        fanSpeed = FAN_MIN;
+    }
+
+    return true;
+}
+
+// Modes with a target temperature to hold
+bool Thermostat::controls(Mode mode) {
+    return mode == MODE_COOL || mode == MODE_HEAT || mode == MODE_AUTO;
+}
+
+// Modes that run the compressor
+bool Thermostat::compresses(Mode mode) {
+    return mode != MODE_OFF && mode != MODE_FAN;
+}
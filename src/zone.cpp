@@ -0,0 +1,263 @@
+#include "zone.h"
+
+#include "log.h"
+#include "stats.h"
+
+Zone::Zone(const char* topic, uint8_t pin, IrBackend& backend) : topic(topic), pin(pin), backend(backend) {
+    lastCommand = 0;
+    modeChangedAt = 0;
+    coalesced = 0;
+    deduplicated = 0;
+    sendPending = false;
+    forceSend = false;
+    pendingSince = 0;
+    sentHash = 0;
+    sentAt = 0;
+    sentAny = false;
+
+    // Default Settings
+    state.mode = MODE_OFF;
+    state.fanSpeed = FAN_AUTO;
+    state.temperature = 23;
+    state.swing = SWING_BOTH;
+    state.quiet = false;
+    state.powerful = false;
+
+    // nothing has been broadcast yet
+    published.currentTemperature = NAN;
+    published.currentHumidity = NAN;
+}
+
+void Zone::begin() {
+    LOG_INFO("Zone %s: %s on GPIO%u", topic, backend.name(), pin);
+    backend.begin();
+}
+
+// Pushes the whole state into the protocol object, e.g. after a restore
+void Zone::apply() {
+    apply(state);
+}
+
+// Sets every field from `value`, e.g. a frame of the AC's remote
+void Zone::apply(const AcState& value) {
+    AcState target = value;  // `value` may be `state`, which the setters change
+
+    setTargetMode(target.mode);
+    setTargetFanSpeed(target.fanSpeed);
+    setTemperature(target.temperature);
+    setVerticalSwing(target.verticalSwing());
+    setHorizontalSwing(target.horizontalSwing());
+    setQuietMode(target.quiet);
+    setPowerfulMode(target.powerful);
+}
+
+// Sends the state once the current burst of commands is over, Homebridge
+// usually sends each changed characteristic in its own frame
+void Zone::queueSend(bool force) {
+    lastCommand = millis();
+    forceSend |= force;
+
+    if (sendPending) {
+        coalesced++;
+        return;
+    }
+
+    sendPending = true;
+    pendingSince = lastCommand;
+}
+
+// True once a queued frame is due
+bool Zone::ready(unsigned long now) const {
+    return sendPending && (now - lastCommand >= SEND_QUIET_MS || now - pendingSince >= SEND_MAX_DELAY_MS);
+}
+
+// Milliseconds since the first command of the queued frame
+unsigned long Zone::waited(unsigned long now) const {
+    return now - pendingSince;
+}
+
+// True when the AC already got the frame with `hash` recently, idempotent
+// commands would make it beep. Otherwise remembers it as sent.
+bool Zone::repeats(uint32_t hash) {
+    bool force = forceSend;
+    sendPending = false;
+    forceSend = false;
+
+    if (!force && sentAny && hash == sentHash && millis() - sentAt < SEND_DEDUPE_MS) {
+        deduplicated++;
+        return true;
+    }
+
+    sentHash = hash;
+    sentAt = millis();
+    sentAny = true;
+    return false;
+}
+
+// Drops what the last frame was, e.g. when it never went out, so the next
+// one is sent whatever it holds
+void Zone::forget() {
+    sentAny = false;
+}
+
+// Takes the frame with `hash` as sent, e.g. when the AC's remote sent it
+void Zone::remember(uint32_t hash) {
+    sentHash = hash;
+    sentAt = millis();
+    sentAny = true;
+}
+
+// Returns the fields that differ from the last broadcast, the sensor
+// readings only count once they moved by more than the hysteresis
+uint16_t Zone::changes(float currentTemperature, float currentHumidity) const {
+    uint16_t fields = 0;
+
+    if (isnan(published.currentTemperature)) {
+        // nothing has been broadcast yet
+        return F_ALL;
+    }
+
+    if (fabs(currentTemperature - published.currentTemperature) >= BROADCAST_HYSTERESIS_T) {
+        fields |= F_CURRENT_TEMPERATURE;
+    }
+    if (fabs(currentHumidity - published.currentHumidity) >= BROADCAST_HYSTERESIS_H) {
+        fields |= F_CURRENT_HUMIDITY;
+    }
+    if (state.mode != published.state.mode) {
+        fields |= F_TARGET_MODE;
+    }
+    if (state.fanSpeed != published.state.fanSpeed) {
+        fields |= F_TARGET_FAN_SPEED;
+    }
+    if (state.temperature != published.state.temperature) {
+        fields |= F_TARGET_TEMPERATURE;
+    }
+    if (state.verticalSwing() != published.state.verticalSwing()) {
+        fields |= F_VERTICAL_SWING;
+    }
+    if (state.horizontalSwing() != published.state.horizontalSwing()) {
+        fields |= F_HORIZONTAL_SWING;
+    }
+    if (state.quiet != published.state.quiet) {
+        fields |= F_QUIET_MODE;
+    }
+    if (state.powerful != published.state.powerful) {
+        fields |= F_POWERFUL_MODE;
+    }
+
+    return fields;
+}
+
+// Remembers the broadcast values of the given fields
+void Zone::publish(uint16_t fields, float currentTemperature, float currentHumidity) {
+    if (fields & F_CURRENT_TEMPERATURE) {
+        published.currentTemperature = currentTemperature;
+    }
+    if (fields & F_CURRENT_HUMIDITY) {
+        published.currentHumidity = currentHumidity;
+    }
+    if (fields & F_TARGET_MODE) {
+        published.state.mode = state.mode;
+    }
+    if (fields & F_TARGET_FAN_SPEED) {
+        published.state.fanSpeed = state.fanSpeed;
+    }
+    if (fields & F_TARGET_TEMPERATURE) {
+        published.state.temperature = state.temperature;
+    }
+    if (fields & F_VERTICAL_SWING) {
+        published.state.setSwing(SWING_VERTICAL, state.verticalSwing());
+    }
+    if (fields & F_HORIZONTAL_SWING) {
+        published.state.setSwing(SWING_HORIZONTAL, state.horizontalSwing());
+    }
+    if (fields & F_QUIET_MODE) {
+        published.state.quiet = state.quiet;
+    }
+    if (fields & F_POWERFUL_MODE) {
+        published.state.powerful = state.powerful;
+    }
+}
+
+void Zone::setTargetMode(Mode value) {
+    STATS_TIME(STAT_SET_MODE);
+
+    backend.setMode(value);
+
+    if (value != state.mode) {
+        LOG_INFO("[%s] Target Mode Changed: %s", topic, modeName(value));
+        state.mode = value;
+        modeChangedAt = millis();
+    }
+}
+
+void Zone::setTargetFanSpeed(FanSpeed value) {
+    STATS_TIME(STAT_SET_FAN_SPEED);
+
+    backend.setFanSpeed(value);
+
+    if (value != state.fanSpeed) {
+        LOG_INFO("[%s] Target Fan Speed: %s", topic, fanSpeedName(value));
+        state.fanSpeed = value;
+    }
+}
+
+void Zone::setTemperature(int value) {
+    STATS_TIME(STAT_SET_TEMPERATURE);
+
+    // in the range the backend takes, it would wrap -1 to 255 and clamp that
+    uint8_t temperature = constrain(value, backend.minTemperature(), backend.maxTemperature());
+    backend.setTemperature(temperature);
+    LOG_INFO("[%s] Target Temperature: %d", topic, temperature);
+    state.temperature = temperature;
+}
+
+void Zone::setVerticalSwing(bool value) {
+    STATS_TIME(STAT_SET_VERTICAL_SWING);
+
+    backend.setVerticalSwing(value);
+    if (value != state.verticalSwing()) {
+        LOG_INFO("[%s] Vertical Swing: %d", topic, value);
+        state.setSwing(SWING_VERTICAL, value);
+    }
+}
+
+void Zone::setHorizontalSwing(bool value) {
+    STATS_TIME(STAT_SET_HORIZONTAL_SWING);
+
+    backend.setHorizontalSwing(value);
+    if (value != state.horizontalSwing()) {
+        LOG_INFO("[%s] Horizontal Swing: %d", topic, value);
+        state.setSwing(SWING_HORIZONTAL, value);
+    }
+}
+
+void Zone::setQuietMode(bool value) {
+    STATS_TIME(STAT_SET_QUIET);
+
+    backend.setQuiet(value);
+    if (value != state.quiet) {
+        LOG_INFO("[%s] Quiet Mode: %d", topic, value);
+        state.quiet = value;
+    }
+
+    if (value) {
+        // cannot be powerful and quiet
+        setPowerfulMode(false);
+    }
+}
+
+void Zone::setPowerfulMode(bool value) {
+    STATS_TIME(STAT_SET_POWERFUL);
+
+    backend.setPowerful(value);
+    if (value != state.powerful) {
+        LOG_INFO("[%s] Powerful Mode: %d", topic, value);
+        state.powerful = value;
+    }
+
+    if (value) {
+        // cannot be quiet and powerful
+        setQuietMode(false);
+    }
+}
@@ -0,0 +1,250 @@
+#include <Arduino.h>
+
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+volatile uint32_t GPOS_REG, GPOC_REG;
+
+// The linker script places the EEPROM sector here on the device, Store only
+// needs an address 4 KB aligned relative to the flash mapping
+extern "C" {
+alignas(4096) uint32_t _EEPROM_start;
+}
+
+static const auto started = std::chrono::steady_clock::now();
+static uint8_t pins[17];
+
+unsigned long millis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+unsigned long micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+uint64_t micros64() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin < sizeof(pins)) {
+        pins[pin] = value;
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < sizeof(pins) ? pins[pin] : LOW;
+}
+
+void attachInterruptArg(uint8_t, void (*)(void*), void*, int) {}
+void detachInterrupt(uint8_t) {}
+void noInterrupts() {}
+void interrupts() {}
+
+int vsnprintf_P(char* out, size_t size, const char* format, va_list args) {
+    return vsnprintf(out, size, format, args);
+}
+
+void configTime(const char*, const char*, const char*, const char*) {}
+
+/* String */
+
+void String::replace(const char* from, const char* to) {
+    size_t length = strlen(from);
+    if (length == 0) {
+        return;
+    }
+
+    for (size_t at = value.find(from); at != std::string::npos; at = value.find(from, at + strlen(to))) {
+        value.replace(at, length, to);
+    }
+}
+
+String String::substring(int from, int to) const {
+    return String(value.substr(from, to - from).c_str());
+}
+
+void String::toCharArray(char* out, unsigned size) const {
+    if (size == 0) {
+        return;
+    }
+    strncpy(out, value.c_str(), size - 1);
+    out[size - 1] = '\0';
+}
+
+void String::toLowerCase() {
+    for (char& c : value) {
+        c = tolower(c);
+    }
+}
+
+String& String::operator+=(const char* s) {
+    value += s;
+    return *this;
+}
+
+bool String::operator==(const char* s) const {
+    return value == s;
+}
+
+bool String::operator!=(const String& s) const {
+    return value != s.value;
+}
+
+String operator+(const char* a, const String& b) {
+    String result(a);
+    result += b.c_str();
+    return result;
+}
+
+/* Print */
+
+size_t Print::write(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        write(data[i]);
+    }
+    return length;
+}
+
+int Print::availableForWrite() {
+    return 128;
+}
+
+size_t Print::print(const char* s) {
+    return write((const uint8_t*)s, strlen(s));
+}
+
+size_t Print::print(int n) {
+    return printf("%d", n);
+}
+
+size_t Print::println(const char* s) {
+    return print(s) + print("\r\n");
+}
+
+size_t Print::println(int n) {
+    return print(n) + print("\r\n");
+}
+
+size_t Print::println(const String& s) {
+    return println(s.c_str());
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    return write((const uint8_t*)buffer, (size_t)length < sizeof(buffer) ? length : sizeof(buffer) - 1);
+}
+
+void Print::flush() {}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t length) {
+    if (!quiet) {
+        fwrite(data, 1, length, stdout);
+    }
+    return length;
+}
+
+void HardwareSerial::begin(unsigned long, int, int) {}
+
+/* EspClass */
+
+uint32_t EspClass::getFreeHeap() {
+    return 40000;
+}
+
+uint8_t EspClass::getHeapFragmentation() {
+    return 0;
+}
+
+uint32_t EspClass::getMaxFreeBlockSize() {
+    return 40000;
+}
+
+uint32_t EspClass::getCycleCount() {
+    return micros() * 80;
+}
+
+void EspClass::reset() {
+    abort();
+}
+
+void EspClass::restart() {
+    abort();
+}
+
+bool EspClass::flashEraseSector(uint32_t) {
+    memset(flash, 0xFF, sizeof(flash));
+    flashErases++;
+    return true;
+}
+
+// Like the SPI flash, writing can only clear bits
+bool EspClass::flashWrite(uint32_t address, uint32_t* data, size_t size) {
+    address %= kFlashSize;
+    if (address % 4 || size % 4 || address + size > kFlashSize) {
+        return false;
+    }
+
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        flash[address + i] &= bytes[i];
+    }
+    flashWrites++;
+    return true;
+}
+
+bool EspClass::flashRead(uint32_t address, uint32_t* data, size_t size) {
+    address %= kFlashSize;
+    if (address % 4 || address + size > kFlashSize) {
+        return false;
+    }
+
+    memcpy(data, flash + address, size);
+    return true;
+}
+
+/* IPAddress */
+
+String IPAddress::toString() const {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buffer);
+}
+
+bool IPAddress::fromString(const char* s) {
+    unsigned a, b, c, d;
+    if (sscanf(s, "%u.%u.%u.%u", &a, &b, &c, &d) != 4) {
+        return false;
+    }
+    *this = IPAddress(a, b, c, d);
+    return true;
+}
+
+/* timer1 */
+
+void timer1_isr_init() {}
+void timer1_attachInterrupt(timercallback) {}
+void timer1_enable(uint8_t, uint8_t, uint8_t) {}
+void timer1_disable() {}
+void timer1_write(uint32_t) {}
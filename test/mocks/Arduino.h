@@ -0,0 +1,188 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// Just enough of the ESP8266 Arduino core to run the Ac core on the host.
+// Time comes from the host clock, flash is one in-memory sector and pins
+// read back whatever was last written to them.
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define PSTR(x) (x)
+#define F(x) (x)
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define HIGH 1
+#define LOW 0
+#define CHANGE 3
+#define LED_BUILTIN 2
+
+typedef bool boolean;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+unsigned long micros();
+uint64_t micros64();
+void delay(unsigned long ms);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+#define digitalPinToInterrupt(p) (p)
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+void noInterrupts();
+void interrupts();
+// masks interrupts and restores the previous level, nothing to mask here
+#define xt_rsil(level) (0 * (level))
+#define xt_wsr_ps(state) ((void)(state))
+
+int vsnprintf_P(char* out, size_t size, const char* format, va_list args);
+
+// time() is the host clock, so it counts as set by NTP
+void configTime(const char* tz, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+
+class String {
+   public:
+    String(const char* s = "") : value(s ? s : "") {}
+    String(int n) : value(std::to_string(n)) {}
+
+    const char* c_str() const {
+        return value.c_str();
+    }
+
+    size_t length() const {
+        return value.length();
+    }
+
+    void replace(const char* from, const char* to);
+    String substring(int from, int to) const;
+    void toCharArray(char* out, unsigned size) const;
+    void toLowerCase();
+    String& operator+=(const char* s);
+    bool operator==(const char* s) const;
+    bool operator!=(const String& s) const;
+    friend String operator+(const char* a, const String& b);
+
+   private:
+    std::string value;
+};
+
+class Print {
+   public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* data, size_t length);
+    virtual int availableForWrite();
+    size_t print(const char* s);
+    size_t print(int n);
+    size_t println(const char* s = "");
+    size_t println(int n);
+    size_t println(const String& s);
+    size_t printf(const char* format, ...);
+    void flush();
+};
+
+// Writes to stdout, unless quiet is set to keep benchmark output readable
+class HardwareSerial : public Print {
+   public:
+    using Print::write;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    void begin(unsigned long baud, int config = 0, int mode = 0);
+
+    bool quiet = false;
+};
+
+extern HardwareSerial Serial;
+
+#define SERIAL_8N1 0
+#define SERIAL_TX_ONLY 0
+
+class EspClass {
+   public:
+    static const size_t kFlashSize = 4096;
+
+    EspClass() {
+        memset(flash, 0xFF, sizeof(flash));
+    }
+
+    uint32_t getFreeHeap();
+    uint8_t getHeapFragmentation();
+    uint32_t getMaxFreeBlockSize();
+    uint32_t getCycleCount();
+    void reset();
+    void restart();
+
+    // every address maps into the one sector the store uses
+    bool flashEraseSector(uint32_t sector);
+    bool flashWrite(uint32_t address, uint32_t* data, size_t size);
+    bool flashRead(uint32_t address, uint32_t* data, size_t size);
+
+    uint8_t flash[kFlashSize];
+    unsigned long flashWrites = 0;
+    unsigned long flashErases = 0;
+};
+
+extern EspClass ESP;
+
+class IPAddress {
+   public:
+    IPAddress() : address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+    IPAddress(uint32_t address) : address(address) {}
+
+    operator uint32_t() const {
+        return address;
+    }
+
+    bool isSet() const {
+        return address != 0;
+    }
+
+    uint8_t operator[](int i) const {
+        return address >> (i * 8);
+    }
+
+    String toString() const;
+    bool fromString(const char* s);
+
+   private:
+    uint32_t address;
+};
+
+// GPIO set / clear registers the IR transmitter drives
+extern volatile uint32_t GPOS_REG, GPOC_REG;
+#define GPOS GPOS_REG
+#define GPOC GPOC_REG
+
+// timer1 never fires on the host, a started frame stays busy
+#define TIM_DIV1 0
+#define TIM_EDGE 0
+#define TIM_SINGLE 0
+#define TIM_LOOP 1
+typedef void (*timercallback)(void);
+void timer1_isr_init();
+void timer1_attachInterrupt(timercallback callback);
+void timer1_enable(uint8_t divider, uint8_t edge, uint8_t reload);
+void timer1_disable();
+void timer1_write(uint32_t ticks);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef ESP8266WebServer_h
+#define ESP8266WebServer_h
+
+#include <Arduino.h>
+
+#include <functional>
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST };
+
+// Never gets a request, only counts what a handler sends
+class ESP8266WebServer {
+   public:
+    explicit ESP8266WebServer(int) {}
+
+    void begin() {}
+    void handleClient() {}
+    void on(const char*, HTTPMethod, std::function<void()>) {}
+    void onNotFound(std::function<void()>) {}
+    void setContentLength(size_t) {}
+    void send(int, const char*, const char*) {}
+
+    void sendContent(const char*, size_t length) {
+        bytes += length;
+        chunks++;
+    }
+
+    size_t bytes = 0;
+    unsigned long chunks = 0;
+};
+
+#endif
@@ -0,0 +1,3 @@
+#include "ESP8266WiFi.h"
+
+ESP8266WiFiClass WiFi;
@@ -0,0 +1,116 @@
+#ifndef ESP8266WiFi_h
+#define ESP8266WiFi_h
+
+#include <Arduino.h>
+#include <lwip/opt.h>
+
+enum WiFiMode_t { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+enum WiFiSleepType_t { WIFI_NONE_SLEEP, WIFI_LIGHT_SLEEP, WIFI_MODEM_SLEEP };
+enum wl_status_t { WL_IDLE_STATUS, WL_NO_SSID_AVAIL, WL_SCAN_COMPLETED, WL_CONNECTED, WL_CONNECT_FAILED, WL_CONNECTION_LOST, WL_WRONG_PASSWORD, WL_DISCONNECTED };
+
+// Never connected, so the syslog sink stays quiet, and nothing is stored
+class ESP8266WiFiClass {
+   public:
+    bool mode(WiFiMode_t) {
+        return true;
+    }
+
+    bool persistent(bool) {
+        return true;
+    }
+
+    wl_status_t begin(const char*, const char* = nullptr, int32_t = 0, const uint8_t* = nullptr, bool = true) {
+        return WL_DISCONNECTED;
+    }
+
+    bool disconnect(bool = false) {
+        return true;
+    }
+
+    bool setAutoReconnect(bool) {
+        return true;
+    }
+
+    int32_t RSSI() {
+        return -60;
+    }
+
+    String SSID() {
+        return String("");
+    }
+
+    String psk() {
+        return String("");
+    }
+
+    uint8_t* BSSID() {
+        return bssid;
+    }
+
+    int32_t channel() {
+        return 0;
+    }
+
+    bool isConnected() {
+        return false;
+    }
+
+    wl_status_t status() {
+        return WL_DISCONNECTED;
+    }
+
+    bool setSleepMode(WiFiSleepType_t type, uint8_t listenInterval = 0) {
+        sleepMode = type;
+        this->listenInterval = listenInterval;
+        return true;
+    }
+
+    String macAddress() {
+        return String("5C:CF:7F:00:00:01");
+    }
+
+    IPAddress localIP() {
+        return IPAddress(127, 0, 0, 1);
+    }
+
+    WiFiSleepType_t sleepMode = WIFI_NONE_SLEEP;
+    uint8_t listenInterval = 0;
+    uint8_t bssid[6] = {};
+};
+
+extern ESP8266WiFiClass WiFi;
+
+// Room in the TCP send buffer is whatever the test sets, empty by default
+class WiFiClient {
+   public:
+    size_t availableForWrite() {
+        return room;
+    }
+
+    bool connected() {
+        return true;
+    }
+
+    size_t room = TCP_SND_BUF;
+};
+
+class WiFiUDP {
+   public:
+    int beginPacket(const char*, uint16_t) {
+        return 1;
+    }
+
+    int beginPacket(IPAddress, uint16_t) {
+        return 1;
+    }
+
+    size_t write(const uint8_t*, size_t length) {
+        return length;
+    }
+
+    int endPacket() {
+        return 1;
+    }
+};
+
+#endif
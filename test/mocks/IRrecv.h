@@ -0,0 +1,30 @@
+#ifndef IRrecv_h
+#define IRrecv_h
+
+#include <IRremoteESP8266.h>
+
+const uint16_t kStateSizeMax = 53;
+
+struct decode_results {
+    decode_type_t decode_type;
+    uint16_t bits;
+    uint8_t state[kStateSizeMax];
+    bool overflow;
+    bool repeat;
+};
+
+// Never captures anything, there is no pin on the host
+class IRrecv {
+   public:
+    IRrecv(uint16_t, uint16_t = 1024, uint8_t = 15, bool = false) {}
+
+    void enableIRIn(bool = false) {}
+    void disableIRIn() {}
+    void resume() {}
+
+    bool decode(decode_results*) {
+        return false;
+    }
+};
+
+#endif
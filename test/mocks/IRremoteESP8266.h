@@ -0,0 +1,11 @@
+#ifndef IRremoteESP8266_h
+#define IRremoteESP8266_h
+
+#include <Arduino.h>
+
+#define SEND_DAIKIN 1
+#define SEND_PANASONIC_AC 1
+
+enum decode_type_t { UNKNOWN = -1, DAIKIN = 16, PANASONIC_AC = 49 };
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef IRsend_h
+#define IRsend_h
+
+#include <IRremoteESP8266.h>
+
+// Protocol classes of the mock keep every setting in a byte of their raw
+// state, so equal settings give equal bytes the way the real ones do
+enum IrMockByte : uint8_t { IR_POWER, IR_MODE, IR_FAN, IR_TEMP, IR_SWING_V, IR_SWING_H, IR_QUIET, IR_POWERFUL, IR_MODEL };
+
+template <uint16_t N>
+class IrMockAc {
+   public:
+    IrMockAc() {
+        memset(state, 0, sizeof(state));
+    }
+
+    void begin() {}
+
+    void send(uint16_t = 0) {
+        sent++;
+    }
+
+    uint8_t* getRaw() {
+        return state;
+    }
+
+    void setRaw(const uint8_t* data, uint16_t length = N) {
+        memcpy(state, data, length < N ? length : N);
+    }
+
+    bool getPower() {
+        return state[IR_POWER];
+    }
+
+    uint8_t getMode() {
+        return state[IR_MODE];
+    }
+
+    uint8_t getFan() {
+        return state[IR_FAN];
+    }
+
+    uint8_t getTemp() {
+        return state[IR_TEMP];
+    }
+
+    uint8_t getSwingVertical() {
+        return state[IR_SWING_V];
+    }
+
+    uint8_t getSwingHorizontal() {
+        return state[IR_SWING_H];
+    }
+
+    bool getQuiet() {
+        return state[IR_QUIET];
+    }
+
+    bool getPowerful() {
+        return state[IR_POWERFUL];
+    }
+
+    String toString() {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "Power: %u, Mode: %u, Temp: %uC, Fan: %u", state[IR_POWER], state[IR_MODE], state[IR_TEMP], state[IR_FAN]);
+        return String(buffer);
+    }
+
+    int sent = 0;
+
+   protected:
+    uint8_t state[N];
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "WebSocketsServer.h"
+
+#include <stdlib.h>
+
+WebSocketsServer::WebSocketsServer(uint16_t) {
+    messages = 0;
+    bytes = 0;
+    lastLength = 0;
+    for (WSclient_t& client : _clients) {
+        client.tcp = nullptr;
+        client.status = 0;
+    }
+}
+
+// Without the header room in front of the payload the library copies short
+// messages into a buffer it allocates, so the mock does too
+bool WebSocketsServer::record(uint8_t num, size_t length, bool headerToPayload) {
+    if (!clientIsConnected(num)) {
+        return false;
+    }
+
+    if (!headerToPayload && length > 0 && length < 1400) {
+        free(malloc(length + WEBSOCKETS_MAX_HEADER_SIZE));
+    }
+
+    messages++;
+    bytes += length;
+    lastLength = length;
+    return true;
+}
+
+bool WebSocketsServer::sendTXT(uint8_t num, char* payload, size_t length, bool headerToPayload) {
+    return record(num, length ? length : strlen(payload), headerToPayload);
+}
+
+bool WebSocketsServer::sendTXT(uint8_t num, const char* payload, size_t length) {
+    return record(num, length ? length : strlen(payload), false);
+}
+
+bool WebSocketsServer::sendTXT(uint8_t num, const uint8_t* payload, size_t length) {
+    return sendTXT(num, (const char*)payload, length);
+}
+
+bool WebSocketsServer::broadcastTXT(const char* payload, size_t length) {
+    bool sent = false;
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        sent |= sendTXT(num, payload, length);
+    }
+    return sent;
+}
+
+bool WebSocketsServer::sendBIN(uint8_t num, uint8_t*, size_t length, bool headerToPayload) {
+    return record(num, length, headerToPayload);
+}
+
+bool WebSocketsServer::sendBIN(uint8_t num, const uint8_t*, size_t length) {
+    return record(num, length, false);
+}
+
+bool WebSocketsServer::broadcastBIN(const uint8_t* payload, size_t length) {
+    bool sent = false;
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        sent |= sendBIN(num, payload, length);
+    }
+    return sent;
+}
+
+bool WebSocketsServer::clientIsConnected(uint8_t num) {
+    return num < WEBSOCKETS_SERVER_CLIENT_MAX && _clients[num].tcp != nullptr;
+}
+
+uint8_t WebSocketsServer::connectedClients(bool) {
+    uint8_t count = 0;
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        count += clientIsConnected(num);
+    }
+    return count;
+}
+
+void WebSocketsServer::disconnect(uint8_t num) {
+    if (!clientIsConnected(num)) {
+        return;
+    }
+
+    _clients[num].tcp = nullptr;
+    if (event) {
+        event(num, WStype_DISCONNECTED, nullptr, 0);
+    }
+}
+
+void WebSocketsServer::connect(uint8_t num) {
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || clientIsConnected(num)) {
+        return;
+    }
+
+    _clients[num].tcp = &sockets[num];
+    if (event) {
+        event(num, WStype_CONNECTED, nullptr, 0);
+    }
+}
+
+void WebSocketsServer::setRoom(uint8_t num, size_t room) {
+    sockets[num].room = room;
+}
+
+void WebSocketsServer::receive(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
+    if (event) {
+        event(num, type, payload, length);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef WebSocketsServer_h
+#define WebSocketsServer_h
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+typedef enum { WStype_ERROR, WStype_DISCONNECTED, WStype_CONNECTED, WStype_TEXT, WStype_BIN, WStype_FRAGMENT_TEXT_START, WStype_FRAGMENT_BIN_START, WStype_FRAGMENT, WStype_FRAGMENT_FIN, WStype_PING, WStype_PONG } WStype_t;
+
+#define WEBSOCKETS_SERVER_CLIENT_MAX 5
+#define WEBSOCKETS_MAX_HEADER_SIZE (14)
+
+struct WSclient_t {
+    WiFiClient* tcp;
+    int status;
+};
+
+// Records what would have gone out instead of sending it. Tests connect
+// clients and feed them messages through receive().
+class WebSocketsServer {
+   public:
+    typedef std::function<void(uint8_t num, WStype_t type, uint8_t* payload, size_t length)> WebSocketServerEvent;
+
+    explicit WebSocketsServer(uint16_t port);
+
+    void begin() {}
+    void loop() {}
+    void close() {}
+
+    void onEvent(WebSocketServerEvent callback) {
+        event = callback;
+    }
+
+    bool sendTXT(uint8_t num, char* payload, size_t length = 0, bool headerToPayload = false);
+    bool sendTXT(uint8_t num, const char* payload, size_t length = 0);
+    bool sendTXT(uint8_t num, const uint8_t* payload, size_t length = 0);
+    bool broadcastTXT(const char* payload, size_t length = 0);
+    bool sendBIN(uint8_t num, uint8_t* payload, size_t length, bool headerToPayload = false);
+    bool sendBIN(uint8_t num, const uint8_t* payload, size_t length);
+    bool broadcastBIN(const uint8_t* payload, size_t length);
+    bool clientIsConnected(uint8_t num);
+    uint8_t connectedClients(bool ping = false);
+    void disconnect(uint8_t num);
+
+    // test side
+    void connect(uint8_t num);
+    void receive(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
+    void setRoom(uint8_t num, size_t room);
+
+    unsigned long messages;
+    unsigned long bytes;
+    size_t lastLength;
+
+   protected:
+    WSclient_t _clients[WEBSOCKETS_SERVER_CLIENT_MAX];
+
+   private:
+    WebSocketServerEvent event;
+    WiFiClient sockets[WEBSOCKETS_SERVER_CLIENT_MAX];
+
+    bool record(uint8_t num, size_t length, bool headerToPayload);
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef IR_Daikin_h
+#define IR_Daikin_h
+
+#include <IRsend.h>
+
+const uint8_t kDaikinAuto = 0, kDaikinDry = 2, kDaikinCool = 3, kDaikinHeat = 4, kDaikinFan = 6;
+const uint8_t kDaikinFanMin = 1, kDaikinFanMax = 5, kDaikinFanAuto = 0xA;
+const uint8_t kDaikinMinTemp = 10, kDaikinMaxTemp = 32;
+const uint16_t kDaikinStateLength = 35;
+
+#define DAIKIN_COOL kDaikinCool
+#define DAIKIN_HEAT kDaikinHeat
+#define DAIKIN_FAN kDaikinFan
+#define DAIKIN_AUTO kDaikinAuto
+#define DAIKIN_DRY kDaikinDry
+#define DAIKIN_FAN_AUTO kDaikinFanAuto
+#define DAIKIN_FAN_MIN kDaikinFanMin
+#define DAIKIN_FAN_MAX kDaikinFanMax
+
+class IRDaikinESP : public IrMockAc<kDaikinStateLength> {
+   public:
+    explicit IRDaikinESP(uint16_t, bool = false, bool = true) {}
+
+    void on() {
+        state[IR_POWER] = 1;
+    }
+
+    void off() {
+        state[IR_POWER] = 0;
+    }
+
+    void setMode(uint8_t value) {
+        state[IR_MODE] = value;
+    }
+
+    void setFan(uint8_t value) {
+        state[IR_FAN] = value;
+    }
+
+    void setTemp(uint8_t value) {
+        state[IR_TEMP] = value;
+    }
+
+    void setSwingVertical(bool value) {
+        state[IR_SWING_V] = value;
+    }
+
+    void setSwingHorizontal(bool value) {
+        state[IR_SWING_H] = value;
+    }
+
+    void setQuiet(bool value) {
+        state[IR_QUIET] = value;
+    }
+
+    void setPowerful(bool value) {
+        state[IR_POWERFUL] = value;
+    }
+};
+
+#endif
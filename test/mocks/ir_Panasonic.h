@@ -0,0 +1,59 @@
+#ifndef IR_Panasonic_h
+#define IR_Panasonic_h
+
+#include <IRsend.h>
+
+const uint8_t kPanasonicAcAuto = 0, kPanasonicAcDry = 2, kPanasonicAcCool = 3, kPanasonicAcHeat = 4, kPanasonicAcFan = 6;
+const uint8_t kPanasonicAcFanMin = 0, kPanasonicAcFanMax = 4, kPanasonicAcFanAuto = 7;
+const uint8_t kPanasonicAcSwingVHighest = 1, kPanasonicAcSwingVAuto = 0xF, kPanasonicAcSwingHAuto = 0xD, kPanasonicAcSwingHMiddle = 6;
+const uint8_t kPanasonicAcMinTemp = 16, kPanasonicAcMaxTemp = 30;
+const uint16_t kPanasonicAcStateLength = 27;
+
+enum panasonic_ac_remote_model_t { kPanasonicUnknown = 0, kPanasonicLke, kPanasonicNke, kPanasonicDke, kPanasonicJke, kPanasonicCkp, kPanasonicRkr };
+
+class IRPanasonicAc : public IrMockAc<kPanasonicAcStateLength> {
+   public:
+    explicit IRPanasonicAc(uint16_t, bool = false, bool = true) {}
+
+    void setModel(panasonic_ac_remote_model_t model) {
+        state[IR_MODEL] = model;
+    }
+
+    void on() {
+        state[IR_POWER] = 1;
+    }
+
+    void off() {
+        state[IR_POWER] = 0;
+    }
+
+    void setMode(uint8_t value) {
+        state[IR_MODE] = value;
+    }
+
+    void setFan(uint8_t value) {
+        state[IR_FAN] = value;
+    }
+
+    void setTemp(uint8_t value, bool = true) {
+        state[IR_TEMP] = value;
+    }
+
+    void setSwingVertical(uint8_t value) {
+        state[IR_SWING_V] = value;
+    }
+
+    void setSwingHorizontal(uint8_t value) {
+        state[IR_SWING_H] = value;
+    }
+
+    void setQuiet(bool value) {
+        state[IR_QUIET] = value;
+    }
+
+    void setPowerful(bool value) {
+        state[IR_POWERFUL] = value;
+    }
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef LWIP_OPT_H
+#define LWIP_OPT_H
+
+// As in PlatformIO's default low-memory lwIP variant
+#define TCP_MSS 536
+#define TCP_SND_BUF (2 * TCP_MSS)
+
+#endif
@@ -0,0 +1,207 @@
+// Host benchmarks of the Ac core, run with `pio test -e native`.
+//
+// Every case runs BENCH_ITERATIONS calls and prints the time and the heap
+// allocations per call. Timings depend on the host and are only reported,
+// allocations are not and fail the test when a hot path starts to allocate.
+
+#include <unity.h>
+
+#include <chrono>
+#include <new>
+
+#include "ac.h"
+#include "heap.h"
+
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 20000
+#endif
+
+static Ac ac;
+
+/* Allocation counting */
+
+// malloc and friends are counted in src/heap.cpp, the host's operator new
+// lives in a shared library the linker cannot wrap, so it is replaced here
+void* operator new(size_t size) {
+    void* ptr = malloc(size ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+/* Harness */
+
+struct Result {
+    double ns;           // per call
+    double allocations;  // per call
+};
+
+template <typename Fn>
+static Result measure(const char* name, Fn fn) {
+    fn(0);  // warm up caches and lazily built statics
+
+    uint32_t before = heapAllocations();
+    auto started = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        fn(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - started;
+
+    Result result;
+    result.ns = std::chrono::duration<double, std::nano>(elapsed).count() / BENCH_ITERATIONS;
+    result.allocations = (double)(heapAllocations() - before) / BENCH_ITERATIONS;
+    printf("%-28s %10.0f ns %8.2f allocs\n", name, result.ns, result.allocations);
+    return result;
+}
+
+// Typical Homebridge traffic, parsed in place so every call gets a copy
+static const char* const commands[] = {
+    "{\"targetMode\":\"cool\"}",
+    "{\"targetTemperature\":22}",
+    "{\"targetFanSpeed\":\"max\",\"targetTemperature\":24}",
+    "{\"targetMode\":\"heat\",\"targetFanSpeed\":\"auto\",\"targetTemperature\":21,\"verticalSwing\":true}",
+    "{\"quietMode\":true,\"powerfulMode\":false,\"horizontalSwing\":false}",
+    "{\"targetMode\":\"off\"}",
+};
+
+static const uint8_t kCommandCount = sizeof(commands) / sizeof(commands[0]);
+
+static void request(uint8_t num, const char* command) {
+    char payload[160];
+    size_t length = strlen(command);
+    memcpy(payload, command, length + 1);
+    ac.incomingRequest(num, payload, length);
+}
+
+/* Cases */
+
+void test_incoming_request() {
+    Result result = measure("incomingRequest", [](uint32_t i) { request(0, commands[i % kCommandCount]); });
+    TEST_ASSERT_EQUAL_DOUBLE(0, result.allocations);
+}
+
+// Every query is answered, not just parsed
+void test_incoming_query() {
+    ac.deliver();
+    unsigned long messages = ac.webSocket.messages;
+    Result result = measure("incomingRequest stats", [](uint32_t) { request(0, "{\"stats\":true}"); });
+    TEST_ASSERT_EQUAL_DOUBLE(0, result.allocations);
+    TEST_ASSERT_EQUAL_UINT32(BENCH_ITERATIONS + 1, ac.webSocket.messages - messages);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, ac.webSocket.lastLength);
+}
+
+// The stats reply is larger than even an empty send buffer, so it goes out
+// however little room there is, while a short message waits for room
+void test_incoming_query_small_room() {
+    ac.deliver();
+    ac.webSocket.setRoom(0, 64);
+    unsigned long messages = ac.webSocket.messages;
+
+    request(0, "{\"stats\":true}");
+    TEST_ASSERT_EQUAL_UINT32(messages + 1, ac.webSocket.messages);
+    TEST_ASSERT_GREATER_THAN_UINT32(WebSocketServer::kSendBuffer, ac.webSocket.lastLength);
+
+    ac.broadcast(ac.zones[0], true);
+    TEST_ASSERT_EQUAL_UINT32(messages + 1, ac.webSocket.messages);
+
+    ac.webSocket.setRoom(0, TCP_SND_BUF);
+    ac.deliver();
+    TEST_ASSERT_EQUAL_UINT32(messages + 2, ac.webSocket.messages);
+}
+
+void test_to_json() {
+    static char out[JSON_BUFFER_SIZE];
+    Result result = measure("toJson", [](uint32_t) { ac.toJson(ac.zones[0], out, sizeof(out)); });
+    TEST_ASSERT_EQUAL_DOUBLE(0, result.allocations);
+}
+
+void test_to_msgpack() {
+    static char out[JSON_BUFFER_SIZE];
+    Result result = measure("toMsgPack", [](uint32_t) { ac.toMsgPack(ac.zones[0], out, sizeof(out)); });
+    TEST_ASSERT_EQUAL_DOUBLE(0, result.allocations);
+}
+
+// Every setter with a value that differs from the last call
+void test_setters() {
+    Result result = measure("setters", [](uint32_t i) {
+        Zone& zone = ac.zones[0];
+        bool odd = i & 1;
+        zone.setTargetMode(odd ? MODE_COOL : MODE_HEAT);
+        zone.setTargetFanSpeed(odd ? FAN_MAX : FAN_AUTO);
+        zone.setTemperature(odd ? 22 : 25);
+        zone.setVerticalSwing(odd);
+        zone.setHorizontalSwing(!odd);
+        zone.setQuietMode(odd);
+        zone.setPowerfulMode(!odd);
+    });
+    TEST_ASSERT_EQUAL_DOUBLE(0, result.allocations);
+}
+
+void test_broadcast() {
+    Result result = measure("broadcast + deliver", [](uint32_t) {
+        ac.broadcast(ac.zones[0], true);
+        ac.deliver();
+    });
+    TEST_ASSERT_EQUAL_DOUBLE(0, result.allocations);
+}
+
+void test_restore() {
+    ac.save();
+    ac.store.flush();
+    Result result = measure("restore", [](uint32_t) { ac.restore(); });
+    TEST_ASSERT_EQUAL_DOUBLE(0, result.allocations);
+}
+
+#if METRICS_ENABLED
+void test_metrics() {
+    static ESP8266WebServer server(80);
+    Result result = measure("writeMetrics", [](uint32_t) {
+        MetricsWriter out(server);
+        ac.writeMetrics(out);
+        out.flush();
+    });
+    TEST_ASSERT_EQUAL_DOUBLE(0, result.allocations);
+}
+#endif
+
+int main(int argc, char** argv) {
+    Serial.quiet = true;
+    ac.begin();
+    ac.serve();
+    ac.webSocket.connect(0);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_incoming_request);
+    RUN_TEST(test_incoming_query);
+    RUN_TEST(test_incoming_query_small_room);
+    RUN_TEST(test_to_json);
+    RUN_TEST(test_to_msgpack);
+    RUN_TEST(test_setters);
+    RUN_TEST(test_broadcast);
+    RUN_TEST(test_restore);
+#if METRICS_ENABLED
+    RUN_TEST(test_metrics);
+#endif
+    return UNITY_END();
+}